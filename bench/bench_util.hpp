@@ -0,0 +1,33 @@
+#ifndef EASY_MATCH_BENCH_UTIL_HPP_
+#define EASY_MATCH_BENCH_UTIL_HPP_
+
+#include <chrono>
+#include <cstdio>
+
+namespace bench {
+
+/* keeps the optimizer from discarding a computed value. */
+template<typename T>
+void do_not_optimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+class stopwatch {
+public:
+    stopwatch() : begin_(std::chrono::steady_clock::now()) {}
+
+    double seconds() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin_).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point begin_;
+};
+
+inline void report(const char* name, double items, double seconds) {
+    std::printf("%-40s %10.2f M items/s %10.2f ns/item\n", name, items / seconds / 1e6, seconds * 1e9 / items);
+}
+
+}  // namespace bench
+
+#endif  // EASY_MATCH_BENCH_UTIL_HPP_
@@ -0,0 +1,5 @@
+#!/bin/bash
+
+cd build
+cmake -DCMAKE_BUILD_TYPE=Release ..
+cmake --build . $clean_arg -- -j 2
@@ -0,0 +1,208 @@
+#include "easymatch/easymatch.hpp"
+#include "easymatch/loop.hpp"
+
+#include "bench_util.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace easymatch;
+
+namespace {
+
+constexpr int repeats = 5;
+constexpr uint64_t instructions = 1 << 22;
+
+/* counts branch misses of this thread in user space; unavailable without perf events (e.g. in most VMs). */
+class branch_miss_counter {
+public:
+    branch_miss_counter() {
+#if defined(__linux__)
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+    }
+
+    ~branch_miss_counter() {
+#if defined(__linux__)
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+#endif
+    }
+
+    bool available() const {
+        return fd_ >= 0;
+    }
+
+    void start() {
+#if defined(__linux__)
+        if (fd_ >= 0) {
+            ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    uint64_t stop() {
+        uint64_t count = 0;
+#if defined(__linux__)
+        if (fd_ >= 0) {
+            ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd_, &count, sizeof(count)) != sizeof(count)) {
+                count = 0;
+            }
+        }
+#endif
+        return count;
+    }
+
+private:
+    int fd_ = -1;
+};
+
+enum class Op : uint8_t {
+    load,   // r[a] = b
+    add,    // r[a] = r[b] + r[c]
+    sub,
+    mul,
+    bxor,
+    shr,    // r[a] = r[b] >> (c & 63)
+    loop,   // if (--r[7] != 0) pc = b
+    halt
+};
+
+struct Instr {
+    Op op;
+    uint8_t a;
+    uint8_t b;
+    uint8_t c;
+};
+
+// a loop of random arithmetic over r0..r6, counted down in r7.
+std::vector<Instr> make_program(std::mt19937& rng, size_t body) {
+    std::vector<Instr> code;
+    for (uint8_t r = 0; r < 7; ++r) {
+        code.push_back(Instr{Op::load, r, static_cast<uint8_t>(rng() % 256), 0});
+    }
+    auto start = static_cast<uint8_t>(code.size());
+    const Op ops[] = {Op::add, Op::sub, Op::mul, Op::bxor, Op::shr, Op::load};
+    for (size_t i = 0; i < body; ++i) {
+        code.push_back(Instr{ops[rng() % 6], static_cast<uint8_t>(rng() % 7),
+                             static_cast<uint8_t>(rng() % 7), static_cast<uint8_t>(rng() % 7)});
+    }
+    code.push_back(Instr{Op::loop, 0, start, 0});
+    code.push_back(Instr{Op::halt, 0, 0, 0});
+    return code;
+}
+
+// every instruction returns to the single dispatch of match().
+[[gnu::noinline]] uint64_t run_match(const std::vector<Instr>& code, uint64_t& executed) {
+    std::array<uint64_t, 8> r{};
+    r[7] = instructions / code.size() + 1;
+    size_t pc = 0;
+    for (bool running = true; running; ++executed) {
+        const auto& x = code[pc++];
+        match(x.op)(
+            pattern | Op::load = [&] { r[x.a] = x.b; },
+            pattern | Op::add  = [&] { r[x.a] = r[x.b] + r[x.c]; },
+            pattern | Op::sub  = [&] { r[x.a] = r[x.b] - r[x.c]; },
+            pattern | Op::mul  = [&] { r[x.a] = r[x.b] * r[x.c]; },
+            pattern | Op::bxor = [&] { r[x.a] = r[x.b] ^ r[x.c]; },
+            pattern | Op::shr  = [&] { r[x.a] = r[x.b] >> (r[x.c] & 63); },
+            pattern | Op::loop = [&] { pc = --r[7] != 0 ? x.b : pc; },
+            pattern | Op::halt = [&] { running = false; }
+        );
+    }
+    return r[0] ^ r[1] ^ r[2] ^ r[3] ^ r[4] ^ r[5] ^ r[6];
+}
+
+// every arm dispatches the next instruction itself.
+[[gnu::noinline]] uint64_t run_match_loop(const std::vector<Instr>& code, uint64_t& executed) {
+    std::array<uint64_t, 8> r{};
+    r[7] = instructions / code.size() + 1;
+    size_t pc = 0;
+    const Instr* x = nullptr;
+    auto fetch = [&] {
+        x = &code[pc++];
+        ++executed;
+        return x->op;
+    };
+    match_loop(fetch)(
+        pattern | Op::load = [&] { r[x->a] = x->b; },
+        pattern | Op::add  = [&] { r[x->a] = r[x->b] + r[x->c]; },
+        pattern | Op::sub  = [&] { r[x->a] = r[x->b] - r[x->c]; },
+        pattern | Op::mul  = [&] { r[x->a] = r[x->b] * r[x->c]; },
+        pattern | Op::bxor = [&] { r[x->a] = r[x->b] ^ r[x->c]; },
+        pattern | Op::shr  = [&] { r[x->a] = r[x->b] >> (r[x->c] & 63); },
+        pattern | Op::loop = [&] { pc = --r[7] != 0 ? x->b : pc; },
+        pattern | Op::halt = stop_loop
+    );
+    return r[0] ^ r[1] ^ r[2] ^ r[3] ^ r[4] ^ r[5] ^ r[6];
+}
+
+// reports the best of several runs, with the branch misses of that run when they can be counted.
+template<typename Fn>
+uint64_t run(const char* name, const std::vector<Instr>& code, Fn&& fn) {
+    branch_miss_counter misses;
+    double best = 1e9;
+    uint64_t best_misses = 0;
+    uint64_t checksum = 0;
+    uint64_t executed = 0;
+    for (int i = 0; i < repeats; ++i) {
+        executed = 0;
+        misses.start();
+        bench::stopwatch watch;
+        checksum = fn(code, executed);
+        auto seconds = watch.seconds();
+        auto missed = misses.stop();
+        bench::do_not_optimize(checksum);
+        if (seconds < best) {
+            best = seconds;
+            best_misses = missed;
+        }
+    }
+    bench::report(name, static_cast<double>(executed), best);
+    if (misses.available()) {
+        std::printf("%-40s %10.4f branch misses/instruction\n", "",
+                    static_cast<double>(best_misses) / static_cast<double>(executed));
+    } else {
+        std::printf("%-40s %10s branch misses/instruction\n", "", "n/a");
+    }
+    return checksum;
+}
+
+}  // namespace
+
+// a short body is learnt by the branch predictor; a long one is not, and the dispatch mispredicts.
+int main() {
+    std::mt19937 rng(42);
+    for (size_t body : {16, 1024, 8192, 65536}) {
+        auto code = make_program(rng, body);
+        std::printf("program of %zu random instructions per iteration\n", body);
+        auto a = run("  match in a loop", code, run_match);
+        auto b = run("  match_loop", code, run_match_loop);
+        if (a != b) {
+            std::printf("checksums differ\n");
+            return 1;
+        }
+    }
+}
@@ -0,0 +1,84 @@
+#include "easymatch/mailbox.hpp"
+
+#include "bench_util.hpp"
+
+#include <cstdio>
+#include <thread>
+#include <variant>
+#include <vector>
+
+using namespace easymatch;
+
+namespace {
+
+struct Tick {
+    long value;
+};
+
+struct Order {
+    long id;
+    long quantity;
+};
+
+struct Cancel {
+    long id;
+};
+
+using Message = std::variant<Tick, Order, Cancel>;
+
+void run(int producers, long per_producer) {
+    mailbox<Message> box(4096);
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&box, per_producer] {
+            for (long i = 0; i < per_producer; ++i) {
+                switch (i % 3) {
+                    case 0:  box.push(Tick{i});      break;
+                    case 1:  box.push(Order{i, 10}); break;
+                    default: box.push(Cancel{i});    break;
+                }
+            }
+        });
+    }
+
+    long total = producers * per_producer;
+    long received = 0;
+    long checksum = 0;
+    auto dispatch = matcher(
+        pattern | as<Tick>   = [&](const Tick& x)   { checksum += x.value; },
+        pattern | as<Order>  = [&](const Order& x)  { checksum += x.quantity; },
+        pattern | as<Cancel> = [&](const Cancel& x) { checksum -= x.id; }
+    );
+
+    bench::stopwatch watch;
+    while (received < total) {
+        auto n = box.drain(dispatch);
+        if (n == 0) {
+            std::this_thread::yield();
+        }
+        received += static_cast<long>(n);
+    }
+    auto seconds = watch.seconds();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    bench::do_not_optimize(checksum);
+
+    char name[64];
+    std::snprintf(name, sizeof(name), "mailbox %d producer(s)", producers);
+    bench::report(name, static_cast<double>(total), seconds);
+    const auto& stats = box.stats();
+    std::printf("%-40s %10.2f msgs/batch %10.2f ns dispatch/msg %10.2f us max batch\n", "",
+        static_cast<double>(stats.messages) / static_cast<double>(stats.batches),
+        stats.mean_dispatch_ns(), static_cast<double>(stats.max_batch_ns) / 1e3);
+}
+
+}  // namespace
+
+int main() {
+    constexpr long messages = 4'000'000;
+    for (int producers : {1, 2, 4}) {
+        run(producers, messages / producers);
+    }
+}
@@ -0,0 +1,139 @@
+#include "easymatch/easymatch.hpp"
+
+#include "bench_util.hpp"
+
+#include <algorithm>
+#include <any>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace easymatch;
+
+namespace {
+
+struct Node {
+    int kind;
+    long value;
+    char padding[48];
+};
+
+// elements are allocated in order and then shuffled, so neighbouring elements
+// point to unrelated cache lines; the working set is far larger than the last-level cache.
+std::vector<std::unique_ptr<Node>> make_nodes(size_t n, std::mt19937& rng) {
+    std::vector<std::unique_ptr<Node>> nodes;
+    nodes.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        nodes.push_back(std::make_unique<Node>(Node{static_cast<int>(rng() % 4), static_cast<long>(i), {}}));
+    }
+    std::shuffle(nodes.begin(), nodes.end(), rng);
+    return nodes;
+}
+
+std::vector<std::string> make_strings(size_t n, std::mt19937& rng) {
+    std::vector<std::string> strings;
+    strings.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        strings.push_back(std::string(40, 'a') + std::to_string(rng() % 1000000));
+        strings.back().resize(48, 'x');
+    }
+    std::shuffle(strings.begin(), strings.end(), rng);
+    return strings;
+}
+
+// a Node is too large for the small-object buffer of std::any, so each one is a separate heap object.
+std::vector<std::any> make_boxes(size_t n, std::mt19937& rng) {
+    std::vector<std::any> boxes;
+    boxes.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        if (rng() % 4 == 0) {
+            boxes.emplace_back(static_cast<long>(i));
+        } else {
+            boxes.emplace_back(Node{static_cast<int>(rng() % 4), static_cast<long>(i), {}});
+        }
+    }
+    std::shuffle(boxes.begin(), boxes.end(), rng);
+    return boxes;
+}
+
+// touching unrelated memory between runs keeps the inputs cold.
+void evict_caches() {
+    static std::vector<char> garbage(256 << 20);
+    for (size_t i = 0; i < garbage.size(); i += 64) {
+        garbage[i] += 1;
+    }
+    bench::do_not_optimize(garbage[0]);
+}
+
+void run_nodes(const std::vector<std::unique_ptr<Node>>& nodes, size_t distance) {
+    long sum = 0;
+    evict_caches();
+    bench::stopwatch watch;
+    match_each(nodes, distance)(
+        pattern | deref(when([](const Node& x) { return x.kind == 0; })) = [&](const Node& x) { sum += x.value; },
+        pattern | deref(when([](const Node& x) { return x.kind == 1; })) = [&](const Node& x) { sum -= x.value; },
+        pattern | _                                                      = [] {}
+    );
+    auto seconds = watch.seconds();
+    bench::do_not_optimize(sum);
+
+    char name[64];
+    std::snprintf(name, sizeof(name), "unique_ptr<Node>, distance %zu", distance);
+    bench::report(name, static_cast<double>(nodes.size()), seconds);
+}
+
+void run_strings(const std::vector<std::string>& strings, size_t distance) {
+    long hits = 0;
+    auto needle = std::string(40, 'a') + "123456xx";
+    evict_caches();
+    bench::stopwatch watch;
+    match_each(strings, distance)(
+        pattern | needle = [&] { ++hits; },
+        pattern | _      = [] {}
+    );
+    auto seconds = watch.seconds();
+    bench::do_not_optimize(hits);
+
+    char name[64];
+    std::snprintf(name, sizeof(name), "std::string, distance %zu", distance);
+    bench::report(name, static_cast<double>(strings.size()), seconds);
+}
+
+void run_boxes(const std::vector<std::any>& boxes, size_t distance) {
+    long sum = 0;
+    evict_caches();
+    bench::stopwatch watch;
+    match_each(boxes, distance)(
+        pattern | as<Node> = [&](const Node& x) { sum += x.kind == 0 ? x.value : 0; },
+        pattern | as<long> = [&](long x) { sum -= x; },
+        pattern | _        = [] {}
+    );
+    auto seconds = watch.seconds();
+    bench::do_not_optimize(sum);
+
+    char name[64];
+    std::snprintf(name, sizeof(name), "std::any, distance %zu", distance);
+    bench::report(name, static_cast<double>(boxes.size()), seconds);
+}
+
+}  // namespace
+
+int main() {
+    constexpr size_t n = 4 << 20;
+    std::mt19937 rng(42);
+    auto nodes = make_nodes(n, rng);
+    auto strings = make_strings(n, rng);
+    auto boxes = make_boxes(n, rng);
+
+    for (size_t distance : {0, 4, 8, 16, 32}) {
+        run_nodes(nodes, distance);
+    }
+    for (size_t distance : {0, 4, 8, 16, 32}) {
+        run_strings(strings, distance);
+    }
+    for (size_t distance : {0, 4, 8, 16, 32}) {
+        run_boxes(boxes, distance);
+    }
+}
@@ -0,0 +1,6 @@
+#!/bin/bash
+
+for bench in ./*_bench; do
+    echo "== ${bench}"
+    ${bench}
+done
@@ -0,0 +1,126 @@
+#include "easymatch/metrics.hpp"
+
+#include "bench_util.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+using namespace easymatch;
+
+namespace {
+
+struct Request {
+    int status;
+    long bytes;
+    std::string path;
+};
+
+std::vector<Request> make_requests(size_t n, std::mt19937& rng) {
+    const char* paths[] = {"/api/v1/orders", "/api/v1/users", "/static/app.js", "/health", "/admin/login"};
+    const int statuses[] = {200, 200, 200, 304, 404, 500, 503};
+    std::vector<Request> requests;
+    requests.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        requests.push_back(Request{statuses[rng() % 7], static_cast<long>(rng() % 100000), paths[rng() % 5]});
+    }
+    return requests;
+}
+
+bool is_static(const std::string& path) {
+    return std::string_view(path).substr(0, 8) == "/static/";
+}
+
+bool is_admin(const std::string& path) {
+    return std::string_view(path).substr(0, 7) == "/admin/";
+}
+
+// the arms every variant runs; Make is matcher or sampled_matcher.
+template<typename Make>
+auto classifier(Make&& make) {
+    return make(
+        pattern | ds(one_of(500, 503), _, _)   = 0,
+        pattern | ds(404, _, _)                = 1,
+        pattern | ds(_, _, when(is_admin))     = 2,
+        pattern | ds(_, _, when(is_static))    = 3,
+        pattern | ds(_, (_ > 65536), _)        = 4,
+        pattern | _                            = 5
+    );
+}
+
+template<typename Classify>
+double time_once(const std::vector<Request>& requests, Classify& classify) {
+    long sum = 0;
+    bench::stopwatch watch;
+    for (const auto& x : requests) {
+        sum += classify(std::forward_as_tuple(x.status, x.bytes, x.path));
+    }
+    auto seconds = watch.seconds();
+    bench::do_not_optimize(sum);
+    return seconds;
+}
+
+double median(std::vector<double> values) {
+    auto middle = values.begin() + values.size() / 2;
+    std::nth_element(values.begin(), middle, values.end());
+    return *middle;
+}
+
+}  // namespace
+
+int main() {
+    constexpr size_t n = 1 << 16;
+    constexpr int repeats = 201;
+    std::mt19937 rng(42);
+    auto requests = make_requests(n, rng);
+
+    auto plain = classifier([](const auto&... ps) { return matcher(ps...); });
+    sampled_metrics<6> every(1);
+    auto instrumented = classifier([&](const auto&... ps) { return sampled_matcher(every, ps...); });
+    sampled_metrics<6> site(1000);
+    auto sampled = classifier([&](const auto&... ps) { return sampled_matcher(site, ps...); });
+
+    // the variants run back to back in each repeat, in alternating order, so that frequency
+    // changes and noise hit them alike; the overheads are medians of the per-repeat ratios.
+    std::vector<double> plain_times;
+    std::vector<double> instrumented_times;
+    std::vector<double> sampled_times;
+    std::vector<double> sampled_ratios;
+    std::vector<double> instrumented_ratios;
+    for (int r = 0; r < repeats; ++r) {
+        double t_plain;
+        double t_instrumented;
+        double t_sampled;
+        if (r % 2 == 0) {
+            t_plain = time_once(requests, plain);
+            t_sampled = time_once(requests, sampled);
+            t_instrumented = time_once(requests, instrumented);
+        } else {
+            t_instrumented = time_once(requests, instrumented);
+            t_sampled = time_once(requests, sampled);
+            t_plain = time_once(requests, plain);
+        }
+        plain_times.push_back(t_plain);
+        instrumented_times.push_back(t_instrumented);
+        sampled_times.push_back(t_sampled);
+        sampled_ratios.push_back(t_sampled / t_plain);
+        instrumented_ratios.push_back(t_instrumented / t_plain);
+    }
+
+    auto items = static_cast<double>(n);
+    bench::report("matcher", items, median(plain_times));
+    bench::report("sampled_matcher, every call", items, median(instrumented_times));
+    bench::report("sampled_matcher, 1 in 1000", items, median(sampled_times));
+    // the second figure spreads the measured cost of an instrumented call over the period;
+    // the first one also includes the countdown that every unsampled call pays.
+    std::printf("sampling overhead %.2f %% measured, %.2f %% from the cost of a sample\n",
+                (median(sampled_ratios) - 1) * 100,
+                (median(instrumented_ratios) - 1) / site.period() * 100);
+    std::printf("%llu samples, p99 of sampled calls %llu ns\n",
+                static_cast<unsigned long long>(site.samples()),
+                static_cast<unsigned long long>(site.total().percentile(99)));
+}
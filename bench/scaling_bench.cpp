@@ -0,0 +1,86 @@
+#include "easymatch/parallel.hpp"
+
+#include "bench_util.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace easymatch;
+
+namespace {
+
+struct Request {
+    int method;
+    int status;
+    long bytes;
+    int retries;
+};
+
+enum class Verdict {
+    ok,
+    slow,
+    error,
+    suspicious
+};
+
+// guard cost varies a lot between elements, which the adaptive chunk size has to absorb.
+bool expensive_guard(const Request& x) {
+    unsigned long h = static_cast<unsigned long>(x.bytes);
+    for (int i = 0; i < x.retries * 8; ++i) {
+        h = h * 6364136223846793005UL + 1442695040888963407UL;
+    }
+    return (h >> 60) == 0;
+}
+
+std::vector<Request> make_requests(size_t n) {
+    std::mt19937 rng(7);
+    std::vector<Request> requests(n);
+    for (auto& x : requests) {
+        x.method = static_cast<int>(rng() % 4);
+        x.status = rng() % 10 == 0 ? 500 : 200;
+        x.bytes = static_cast<long>(rng() % 100000);
+        x.retries = rng() % 16 == 0 ? static_cast<int>(rng() % 64) : 0;
+    }
+    return requests;
+}
+
+}  // namespace
+
+int main() {
+    auto requests = make_requests(4 << 20);
+    auto classify = matcher(
+        pattern | when([](const Request& x) { return x.status >= 500; }) = Verdict::error,
+        pattern | when(expensive_guard)                                  = Verdict::suspicious,
+        pattern | when([](const Request& x) { return x.bytes > 90000; }) = Verdict::slow,
+        pattern | _                                                      = Verdict::ok
+    );
+
+    auto cores = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    for (int n = 1;; n = std::min(n * 2, cores)) {
+        batch_options options;
+        for (int core = 0; core < n; ++core) {
+            options.cores.push_back(core);
+        }
+        batch_executor executor(options);
+        static_cast<void>(executor.map(requests, classify));
+
+        bench::stopwatch watch;
+        auto result = executor.map(requests, classify);
+        auto seconds = watch.seconds();
+        bench::do_not_optimize(result.arenas().front().values.size());
+
+        double utilisation = 0;
+        for (const auto& s : executor.stats()) {
+            utilisation += s.utilisation();
+        }
+        char name[64];
+        std::snprintf(name, sizeof(name), "%d pinned workers, %.0f%% busy", n, 100 * utilisation / n);
+        bench::report(name, static_cast<double>(requests.size()), seconds);
+        if (n == cores) {
+            break;
+        }
+    }
+}
@@ -0,0 +1,329 @@
+#include "easymatch/easymatch.hpp"
+
+#include "bench_util.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+using namespace easymatch;
+using std::string_view;
+using namespace std::string_view_literals;
+
+namespace {
+
+constexpr int repeats = 5;
+
+// runs fn() repeatedly and reports the best time; fn returns a checksum.
+template<typename Fn>
+void run(const char* name, double items, Fn&& fn) {
+    double best = 1e9;
+    for (int r = 0; r < repeats; ++r) {
+        bench::stopwatch watch;
+        auto checksum = fn();
+        best = std::min(best, watch.seconds());
+        bench::do_not_optimize(checksum);
+    }
+    bench::report(name, items, best);
+}
+
+/* bytecode interpreter */
+
+enum class Op : uint8_t {
+    load,   // r[a] = b
+    add,    // r[a] = r[b] + r[c]
+    sub,
+    mul,
+    bxor,
+    shr,    // r[a] = r[b] >> (c & 63)
+    loop,   // if (--r[7] != 0) pc = b
+    halt
+};
+
+struct Instr {
+    Op op;
+    uint8_t a;
+    uint8_t b;
+    uint8_t c;
+};
+
+// a loop of random arithmetic over r0..r6, counted down in r7.
+std::vector<Instr> make_program(std::mt19937& rng, size_t body) {
+    std::vector<Instr> code;
+    for (uint8_t r = 0; r < 7; ++r) {
+        code.push_back(Instr{Op::load, r, static_cast<uint8_t>(rng() % 256), 0});
+    }
+    auto start = static_cast<uint8_t>(code.size());
+    const Op ops[] = {Op::add, Op::sub, Op::mul, Op::bxor, Op::shr, Op::load};
+    for (size_t i = 0; i < body; ++i) {
+        code.push_back(Instr{ops[rng() % 6], static_cast<uint8_t>(rng() % 7),
+                             static_cast<uint8_t>(rng() % 7), static_cast<uint8_t>(rng() % 7)});
+    }
+    code.push_back(Instr{Op::loop, 0, start, 0});
+    code.push_back(Instr{Op::halt, 0, 0, 0});
+    return code;
+}
+
+uint64_t interpret(const std::vector<Instr>& code, uint64_t iterations, uint64_t& executed) {
+    std::array<uint64_t, 8> r{};
+    r[7] = iterations;
+    size_t pc = 0;
+    for (bool running = true; running; ++executed) {
+        const auto& x = code[pc++];
+        match(x.op)(
+            pattern | Op::load = [&] { r[x.a] = x.b; },
+            pattern | Op::add  = [&] { r[x.a] = r[x.b] + r[x.c]; },
+            pattern | Op::sub  = [&] { r[x.a] = r[x.b] - r[x.c]; },
+            pattern | Op::mul  = [&] { r[x.a] = r[x.b] * r[x.c]; },
+            pattern | Op::bxor = [&] { r[x.a] = r[x.b] ^ r[x.c]; },
+            pattern | Op::shr  = [&] { r[x.a] = r[x.b] >> (r[x.c] & 63); },
+            pattern | Op::loop = [&] { pc = --r[7] != 0 ? x.b : pc; },
+            pattern | Op::halt = [&] { running = false; }
+        );
+    }
+    return r[0] ^ r[1] ^ r[2] ^ r[3] ^ r[4] ^ r[5] ^ r[6];
+}
+
+/* AST evaluator */
+
+struct Node;
+
+struct Num { double value; };
+struct Var { int slot; };
+struct Add { const Node* lhs; const Node* rhs; };
+struct Mul { const Node* lhs; const Node* rhs; };
+struct Neg { const Node* operand; };
+struct Min { const Node* lhs; const Node* rhs; };
+
+struct Node : std::variant<Num, Var, Add, Mul, Neg, Min> {
+    using variant::variant;
+};
+
+// nodes are owned by the pool in allocation order, children first.
+const Node* make_tree(std::mt19937& rng, int depth, std::vector<std::unique_ptr<Node>>& pool) {
+    auto make = [&](Node node) {
+        pool.push_back(std::make_unique<Node>(node));
+        return pool.back().get();
+    };
+    if (depth == 0 || rng() % 8 == 0) {
+        if (rng() % 2 == 0) {
+            return make(Num{static_cast<double>(rng() % 100) / 10});
+        }
+        return make(Var{static_cast<int>(rng() % 4)});
+    }
+    switch (rng() % 4) {
+        case 0: {
+            auto lhs = make_tree(rng, depth - 1, pool);
+            return make(Add{lhs, make_tree(rng, depth - 1, pool)});
+        }
+        case 1: {
+            auto lhs = make_tree(rng, depth - 1, pool);
+            return make(Mul{lhs, make_tree(rng, depth - 1, pool)});
+        }
+        case 2:
+            return make(Neg{make_tree(rng, depth - 1, pool)});
+        default: {
+            auto lhs = make_tree(rng, depth - 1, pool);
+            return make(Min{lhs, make_tree(rng, depth - 1, pool)});
+        }
+    }
+}
+
+size_t count_nodes(const Node& n) {
+    return match(n)(
+        pattern | as<Add> = [](const Add& x) { return 1 + count_nodes(*x.lhs) + count_nodes(*x.rhs); },
+        pattern | as<Mul> = [](const Mul& x) { return 1 + count_nodes(*x.lhs) + count_nodes(*x.rhs); },
+        pattern | as<Min> = [](const Min& x) { return 1 + count_nodes(*x.lhs) + count_nodes(*x.rhs); },
+        pattern | as<Neg> = [](const Neg& x) { return 1 + count_nodes(*x.operand); },
+        pattern | _       = size_t(1)
+    );
+}
+
+double eval(const Node& n, const std::array<double, 4>& vars) {
+    return match(n)(
+        pattern | as<Num> = [](const Num& x) { return x.value; },
+        pattern | as<Var> = [&](const Var& x) { return vars[x.slot]; },
+        pattern | as<Add> = [&](const Add& x) { return eval(*x.lhs, vars) + eval(*x.rhs, vars); },
+        pattern | as<Mul> = [&](const Mul& x) { return eval(*x.lhs, vars) * eval(*x.rhs, vars); },
+        pattern | as<Neg> = [&](const Neg& x) { return -eval(*x.operand, vars); },
+        pattern | as<Min> = [&](const Min& x) { return std::min(eval(*x.lhs, vars), eval(*x.rhs, vars)); }
+    );
+}
+
+/* log-line classifier */
+
+enum class LogClass {
+    alert,
+    slow_query,
+    server_error,
+    suspicious,
+    client_error,
+    other
+};
+
+std::vector<std::string> make_log(std::mt19937& rng, size_t n) {
+    const char* levels[] = {"INFO", "INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR", "FATAL"};
+    const char* components[] = {"http", "http", "db", "cache", "auth"};
+    const char* paths[] = {"/api/v1/orders", "/api/v1/users", "/static/app.js", "/admin/config",
+                           "/files/../../etc/passwd", "/search?q=%2e%2e"};
+    const int statuses[] = {200, 200, 200, 201, 304, 404, 403, 500, 503};
+    std::vector<std::string> lines;
+    lines.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        std::string line = levels[rng() % 8];
+        line += ' ';
+        line += components[rng() % 5];
+        line += ' ';
+        line += std::to_string(statuses[rng() % 9]);
+        line += rng() % 2 == 0 ? " GET " : " POST ";
+        line += paths[rng() % 6];
+        line += ' ';
+        line += std::to_string(rng() % 2000);
+        line += "ms";
+        lines.push_back(std::move(line));
+    }
+    return lines;
+}
+
+bool is_suspicious(string_view path) {
+    static const std::regex traversal(R"((\.\./|%2e%2e|^/admin/))", std::regex::icase | std::regex::optimize);
+    return std::regex_search(path.begin(), path.end(), traversal);
+}
+
+bool is_slow(string_view duration) {
+    return duration.size() >= 6;  // "1000ms" and above
+}
+
+LogClass classify_line(string_view line) {
+    return match(line)(
+        pattern | fields(' ', one_of("ERROR"sv, "FATAL"sv))                        = LogClass::alert,
+        pattern | fields(' ', "WARN", "db", _, _, _, when(is_slow))                 = LogClass::slow_query,
+        pattern | fields(' ', _, "http", parse<int>(_ >= 500))                      = LogClass::server_error,
+        pattern | fields(' ', "INFO", "http", _, _, when(is_suspicious))            = LogClass::suspicious,
+        pattern | fields(' ', _, _, parse<int>(any_of((_ == 403), (_ == 404))))    = LogClass::client_error,
+        pattern | _                                                                 = LogClass::other
+    );
+}
+
+/* packet header classifier */
+
+enum class Flow {
+    web,
+    dns,
+    ssh,
+    privileged_tcp,
+    other_udp,
+    ipv6,
+    other
+};
+
+constexpr size_t header_size = 42;  // Ethernet + IPv4 + the ports of TCP or UDP
+
+std::vector<uint8_t> make_packets(std::mt19937& rng, size_t n) {
+    std::vector<uint8_t> bytes(n * header_size);
+    for (size_t i = 0; i < n; ++i) {
+        auto p = bytes.data() + i * header_size;
+        for (size_t j = 0; j < header_size; ++j) {
+            p[j] = static_cast<uint8_t>(rng());
+        }
+        bool v6 = rng() % 10 == 0;
+        p[12] = v6 ? 0x86 : 0x08;
+        p[13] = v6 ? 0xdd : 0x00;
+        p[14] = 0x45;
+        p[23] = rng() % 3 == 0 ? 17 : 6;
+        const uint16_t ports[] = {80, 443, 53, 22, 25, 8080, 5353, 123};
+        uint16_t port = rng() % 4 == 0 ? static_cast<uint16_t>(rng()) : ports[rng() % 8];
+        p[36] = static_cast<uint8_t>(port >> 8);
+        p[37] = static_cast<uint8_t>(port);
+    }
+    return bytes;
+}
+
+uint16_t read_u16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] << 8 | p[1]);
+}
+
+Flow classify_packet(const uint8_t* p) {
+    int ethertype = read_u16(p + 12);
+    int protocol = p[23];
+    int port = read_u16(p + 36);
+    return match(ethertype, protocol, port)(
+        pattern | ds(0x86dd, _, _)                      = Flow::ipv6,
+        pattern | ds(0x0800, 6, one_of(80, 443, 8080))  = Flow::web,
+        pattern | ds(0x0800, 17, 53)                    = Flow::dns,
+        pattern | ds(0x0800, 6, 22)                     = Flow::ssh,
+        pattern | ds(0x0800, 6, (_ < 1024))             = Flow::privileged_tcp,
+        pattern | ds(0x0800, 17, _)                     = Flow::other_udp,
+        pattern | _                                     = Flow::other
+    );
+}
+
+}  // namespace
+
+int main() {
+    {
+        std::mt19937 rng(1);
+        auto code = make_program(rng, 64);
+        constexpr uint64_t iterations = 200000;
+        uint64_t executed = 0;
+        static_cast<void>(interpret(code, 1, executed));
+        executed = 0;
+        static_cast<void>(interpret(code, iterations, executed));
+        run("interpreter, instructions", static_cast<double>(executed), [&] {
+            uint64_t n = 0;
+            return interpret(code, iterations, n);
+        });
+    }
+    {
+        std::mt19937 rng(2);
+        std::vector<std::unique_ptr<Node>> pool;
+        std::vector<const Node*> trees;
+        size_t nodes = 0;
+        for (int i = 0; i < 64; ++i) {
+            trees.push_back(make_tree(rng, 14, pool));
+            nodes += count_nodes(*trees.back());
+        }
+        constexpr int rounds = 20;
+        run("AST evaluator, nodes", static_cast<double>(nodes * rounds), [&] {
+            double sum = 0;
+            for (int r = 0; r < rounds; ++r) {
+                std::array<double, 4> vars{r * 0.5, 1.0 - r, 2.0, r * 0.25};
+                for (const auto& tree : trees) {
+                    sum += eval(*tree, vars);
+                }
+            }
+            return sum;
+        });
+    }
+    {
+        std::mt19937 rng(3);
+        auto lines = make_log(rng, 200000);
+        run("log classifier, lines", static_cast<double>(lines.size()), [&] {
+            std::array<size_t, 6> counts{};
+            for (const auto& line : lines) {
+                ++counts[static_cast<size_t>(classify_line(line))];
+            }
+            return counts[0] + counts[3] * 7 + counts[5] * 13;
+        });
+    }
+    {
+        std::mt19937 rng(4);
+        constexpr size_t n = 1 << 20;
+        auto packets = make_packets(rng, n);
+        run("packet classifier, headers", static_cast<double>(n), [&] {
+            std::array<size_t, 7> counts{};
+            for (size_t i = 0; i < n; ++i) {
+                ++counts[static_cast<size_t>(classify_packet(packets.data() + i * header_size))];
+            }
+            return counts[0] + counts[1] * 3 + counts[4] * 7;
+        });
+    }
+}
@@ -0,0 +1,215 @@
+/*
+ *  Copyright (c) 2023 Yosh31207
+ *  Distributed Under The Apache-2.0 License
+ */
+
+#ifndef EASY_MATCH_BYTE_STREAM_HPP_
+#define EASY_MATCH_BYTE_STREAM_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace easymatch {
+
+namespace easymatch_impl {
+
+/* finds the first byte in [first, last) for which table is set, using SIMD compares for few candidates. */
+class first_byte_filter {
+public:
+    static constexpr size_t max_simd_candidates = 4;
+
+    void add(unsigned char byte) {
+        if (!table_[byte]) {
+            table_[byte] = true;
+            candidates_.push_back(byte);
+        }
+    }
+
+    const unsigned char* find(const unsigned char* first, const unsigned char* last) const {
+#if defined(__SSE2__)
+        if (!candidates_.empty() && candidates_.size() <= max_simd_candidates) {
+            __m128i needles[max_simd_candidates];
+            for (size_t i = 0; i < max_simd_candidates; ++i) {
+                needles[i] = _mm_set1_epi8(static_cast<char>(candidates_[i < candidates_.size() ? i : 0]));
+            }
+            for (; last - first >= 16; first += 16) {
+                auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+                auto hits = _mm_cmpeq_epi8(block, needles[0]);
+                for (size_t i = 1; i < candidates_.size(); ++i) {
+                    hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, needles[i]));
+                }
+                if (auto mask = _mm_movemask_epi8(hits); mask != 0) {
+                    return first + __builtin_ctz(static_cast<unsigned>(mask));
+                }
+            }
+        }
+#endif
+        for (; first != last && !table_[*first]; ++first) {}
+        return first;
+    }
+
+private:
+    std::array<bool, 256> table_{};
+    std::vector<unsigned char> candidates_;
+};
+
+}  // namespace easymatch_impl
+
+struct byte_match {
+    size_t signature;   // index of the signature in construction order
+    uint64_t offset;    // stream offset of the first byte of the match
+};
+
+/*
+ * byte_automaton compiles byte signatures into one Aho-Corasick automaton
+ * with a full transition table. It is immutable and can be shared by many streams.
+ */
+class byte_automaton {
+public:
+    byte_automaton(std::initializer_list<std::string_view> signatures)
+        : byte_automaton(std::vector<std::string_view>(signatures)) {}
+
+    explicit byte_automaton(const std::vector<std::string_view>& signatures) {
+        transitions_.resize(256, fail);
+        outputs_.emplace_back();
+        for (size_t i = 0; i < signatures.size(); ++i) {
+            insert(signatures[i], i);
+        }
+        link();
+    }
+
+    size_t signatures() const {
+        return lengths_.size();
+    }
+
+    size_t states() const {
+        return transitions_.size() / 256;
+    }
+
+private:
+    friend class byte_stream_matcher;
+
+    static constexpr uint32_t fail = UINT32_MAX;
+
+    void insert(std::string_view signature, size_t index) {
+        if (signature.empty()) {
+            throw std::invalid_argument("byte signature must not be empty");
+        }
+        filter_.add(static_cast<unsigned char>(signature.front()));
+        uint32_t state = 0;
+        for (auto c : signature) {
+            auto slot = state * 256 + static_cast<unsigned char>(c);
+            if (transitions_[slot] == fail) {
+                transitions_[slot] = static_cast<uint32_t>(outputs_.size());
+                // growing the table invalidates references into it.
+                transitions_.resize(transitions_.size() + 256, fail);
+                outputs_.emplace_back();
+            }
+            state = transitions_[slot];
+        }
+        outputs_[state].push_back(index);
+        lengths_.push_back(signature.size());
+    }
+
+    // breadth-first construction of failure links folded into the transition table.
+    void link() {
+        std::vector<uint32_t> failure(outputs_.size(), 0);
+        std::vector<uint32_t> queue;
+        for (size_t c = 0; c < 256; ++c) {
+            auto& next = transitions_[c];
+            if (next == fail) {
+                next = 0;
+            } else {
+                queue.push_back(next);
+            }
+        }
+        for (size_t i = 0; i < queue.size(); ++i) {
+            auto state = queue[i];
+            auto& out = outputs_[state];
+            const auto& inherited = outputs_[failure[state]];
+            out.insert(out.end(), inherited.begin(), inherited.end());
+            for (size_t c = 0; c < 256; ++c) {
+                auto& next = transitions_[state * 256 + c];
+                auto fallback = transitions_[failure[state] * 256 + c];
+                if (next == fail) {
+                    next = fallback;
+                } else {
+                    failure[next] = fallback;
+                    queue.push_back(next);
+                }
+            }
+        }
+    }
+
+    std::vector<uint32_t> transitions_;
+    std::vector<std::vector<size_t>> outputs_;
+    std::vector<size_t> lengths_;
+    easymatch_impl::first_byte_filter filter_;
+};
+
+/*
+ * byte_stream_matcher runs a byte_automaton over a stream delivered in chunks.
+ * Its state carries over feed() calls, so matches may straddle chunk boundaries;
+ * input is never copied or buffered.
+ */
+class byte_stream_matcher {
+public:
+    explicit byte_stream_matcher(const byte_automaton& automaton)
+        : automaton_(automaton) {}
+
+    /* calls on_match(byte_match) for every signature ending in the chunk. */
+    template<typename OnMatch>
+    void feed(const void* data, size_t size, OnMatch&& on_match) {
+        auto first = static_cast<const unsigned char*>(data);
+        auto last = first + size;
+        auto p = first;
+        while (p != last) {
+            if (state_ == 0) {
+                p = automaton_.filter_.find(p, last);
+                if (p == last) {
+                    break;
+                }
+            }
+            state_ = automaton_.transitions_[state_ * 256 + *p];
+            ++p;
+            for (auto signature : automaton_.outputs_[state_]) {
+                auto end = offset_ + static_cast<uint64_t>(p - first);
+                on_match(byte_match{signature, end - automaton_.lengths_[signature]});
+            }
+        }
+        offset_ += size;
+    }
+
+    template<typename OnMatch>
+    void feed(std::string_view chunk, OnMatch&& on_match) {
+        feed(chunk.data(), chunk.size(), on_match);
+    }
+
+    /* the number of bytes consumed so far. */
+    uint64_t offset() const {
+        return offset_;
+    }
+
+    void reset() {
+        state_ = 0;
+        offset_ = 0;
+    }
+
+private:
+    const byte_automaton& automaton_;
+    uint32_t state_ = 0;
+    uint64_t offset_ = 0;
+};
+
+}  // namespace easymatch
+
+#endif  // EASY_MATCH_BYTE_STREAM_HPP_
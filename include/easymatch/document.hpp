@@ -0,0 +1,519 @@
+/*
+ *  Copyright (c) 2023 Yosh31207
+ *  Distributed Under The Apache-2.0 License
+ */
+
+#ifndef EASY_MATCH_DOCUMENT_HPP_
+#define EASY_MATCH_DOCUMENT_HPP_
+
+#include "easymatch/easymatch.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace easymatch {
+
+struct json_value;
+struct json_member;
+
+struct json_array {
+    const json_value* values = nullptr;
+    size_t count = 0;
+
+    const json_value* begin() const;
+    const json_value* end() const;
+    size_t size() const { return count; }
+    const json_value& operator[](size_t i) const;
+};
+
+struct json_object {
+    const json_member* members = nullptr;
+    size_t count = 0;
+
+    const json_member* begin() const;
+    const json_member* end() const;
+    size_t size() const { return count; }
+
+    /* returns the value of the first member named key, or nullptr. */
+    const json_value* find(std::string_view key) const;
+    const json_value* find(std::string_view key, size_t hash) const;
+};
+
+/*
+ * json_value is a read-only node of a json_document.
+ * Strings are views into the source text, or into the document for strings with escapes.
+ */
+struct json_value : std::variant<std::nullptr_t, bool, double, std::string_view, json_array, json_object> {
+    using std::variant<std::nullptr_t, bool, double, std::string_view, json_array, json_object>::variant;
+};
+
+struct json_member {
+    std::string_view key;
+    size_t hash;
+    json_value value;
+};
+
+inline const json_value* json_array::begin() const {
+    return values;
+}
+
+inline const json_value* json_array::end() const {
+    return values + count;
+}
+
+inline const json_value& json_array::operator[](size_t i) const {
+    return values[i];
+}
+
+inline const json_member* json_object::begin() const {
+    return members;
+}
+
+inline const json_member* json_object::end() const {
+    return members + count;
+}
+
+inline const json_value* json_object::find(std::string_view key, size_t hash) const {
+    for (const auto& member : *this) {
+        if (member.hash == hash && member.key == key) {
+            return &member.value;
+        }
+    }
+    return nullptr;
+}
+
+inline const json_value* json_object::find(std::string_view key) const {
+    return find(key, easymatch_impl::fnv1a(key));
+}
+
+namespace easymatch_impl {
+
+/* key(k, pattern) on documents compares the hashes computed when the pattern was built */
+
+template<typename Value, std::enable_if_t<std::is_same_v<remove_cvref_t<Value>, json_value>, nullptr_t> = nullptr>
+const json_value* find_mapped(Value& value, const hashed_key& key) {
+    auto object = std::get_if<json_object>(&value);
+    return object == nullptr ? nullptr : object->find(key.text, key.hash);
+}
+
+template<typename Value, std::enable_if_t<std::is_same_v<remove_cvref_t<Value>, json_object>, nullptr_t> = nullptr>
+const json_value* find_mapped(Value& object, const hashed_key& key) {
+    return object.find(key.text, key.hash);
+}
+
+template<typename T>
+inline constexpr bool is_json_number_v = std::is_arithmetic_v<T> && !std::is_same_v<T, bool>;
+
+/* types that are ordered against values of the same kind */
+template<typename T>
+inline constexpr bool is_json_ordered_v = is_json_number_v<T> || is_string_like_v<T>;
+
+template<typename T>
+inline constexpr bool is_json_equatable_v =
+    is_json_ordered_v<T> || std::is_same_v<T, bool> || std::is_same_v<T, std::nullptr_t>;
+
+/* compares a value with a literal; values of other kinds are unordered and unequal. */
+template<typename T, typename Compare>
+bool json_compare(const json_value& value, const T& x, Compare compare) {
+    if constexpr (std::is_same_v<T, std::nullptr_t>) {
+        return std::holds_alternative<std::nullptr_t>(value);
+    } else if constexpr (std::is_same_v<T, bool>) {
+        auto flag = std::get_if<bool>(&value);
+        return flag != nullptr && compare(*flag, x);
+    } else if constexpr (is_json_number_v<T>) {
+        auto number = std::get_if<double>(&value);
+        return number != nullptr && compare(*number, static_cast<double>(x));
+    } else {
+        auto text = std::get_if<std::string_view>(&value);
+        return text != nullptr && compare(*text, std::string_view(x));
+    }
+}
+
+// Value is deduced, so literals are never converted to json_value implicitly.
+template<typename Value, typename T, template<typename> typename Trait>
+using enable_json_comparison_t =
+    std::enable_if_t<std::is_same_v<Value, json_value> && Trait<T>::value, nullptr_t>;
+
+template<typename T>
+struct json_equatable : std::bool_constant<is_json_equatable_v<T>> {};
+
+template<typename T>
+struct json_ordered : std::bool_constant<is_json_ordered_v<T>> {};
+
+/* bump allocator for nodes and decoded strings; everything is released with the document. */
+class document_arena {
+public:
+    template<typename T>
+    T* allocate(size_t n) {
+        static_assert(std::is_trivially_destructible_v<T>);
+        auto size = n * sizeof(T);
+        auto offset = (used_ + alignof(T) - 1) / alignof(T) * alignof(T);
+        if (chunks_.empty() || offset + size > capacity_) {
+            capacity_ = std::max(chunk_size, size);
+            chunks_.push_back(std::make_unique<std::byte[]>(capacity_));
+            offset = 0;
+        }
+        used_ = offset + size;
+        return reinterpret_cast<T*>(chunks_.back().get() + offset);
+    }
+
+private:
+    static constexpr size_t chunk_size = 16 * 1024;
+
+    std::vector<std::unique_ptr<std::byte[]>> chunks_;
+    size_t capacity_ = 0;
+    size_t used_ = 0;
+};
+
+}  // namespace easymatch_impl
+
+/* json_values are compared with literals directly. */
+
+#define MAKE_JSON_COMPARISON(op, trait)                                                                      \
+template<typename Value, typename T, easymatch_impl::enable_json_comparison_t<Value, T, trait> = nullptr>   \
+bool operator op (const Value& value, const T& x) {                                                          \
+    return easymatch_impl::json_compare(value, x, [](const auto& l, const auto& r) { return l op r; });      \
+}                                                                                                            \
+template<typename T, typename Value, easymatch_impl::enable_json_comparison_t<Value, T, trait> = nullptr>   \
+bool operator op (const T& x, const Value& value) {                                                          \
+    return easymatch_impl::json_compare(value, x, [](const auto& l, const auto& r) { return r op l; });      \
+}
+
+MAKE_JSON_COMPARISON(==, easymatch_impl::json_equatable)
+MAKE_JSON_COMPARISON(<, easymatch_impl::json_ordered)
+MAKE_JSON_COMPARISON(>, easymatch_impl::json_ordered)
+MAKE_JSON_COMPARISON(<=, easymatch_impl::json_ordered)
+MAKE_JSON_COMPARISON(>=, easymatch_impl::json_ordered)
+
+#undef MAKE_JSON_COMPARISON
+
+template<typename Value, typename T, easymatch_impl::enable_json_comparison_t<Value, T, easymatch_impl::json_equatable> = nullptr>
+bool operator != (const Value& value, const T& x) {
+    return !(value == x);
+}
+
+template<typename T, typename Value, easymatch_impl::enable_json_comparison_t<Value, T, easymatch_impl::json_equatable> = nullptr>
+bool operator != (const T& x, const Value& value) {
+    return !(value == x);
+}
+
+/*
+ * json_document parses JSON text into an arena of json_values.
+ * Strings without escapes are views into the source, which must outlive the document.
+ */
+class json_document {
+public:
+    /* throws std::invalid_argument for malformed text. */
+    explicit json_document(std::string_view source)
+        : source_(source) {
+        skip_space();
+        root_ = parse_value(0);
+        skip_space();
+        if (pos_ != source_.size()) {
+            fail("trailing characters");
+        }
+        values_.clear();
+        values_.shrink_to_fit();
+        members_.clear();
+        members_.shrink_to_fit();
+    }
+
+    const json_value& root() const {
+        return root_;
+    }
+
+private:
+    static constexpr size_t max_depth = 512;
+
+    [[noreturn]] void fail(const char* what) const {
+        throw std::invalid_argument(std::string("json: ") + what + " at offset " + std::to_string(pos_));
+    }
+
+    bool at_end() const {
+        return pos_ == source_.size();
+    }
+
+    char peek() const {
+        return at_end() ? '\0' : source_[pos_];
+    }
+
+    void skip_space() {
+        while (!at_end() && (peek() == ' ' || peek() == '\t' || peek() == '\n' || peek() == '\r')) {
+            ++pos_;
+        }
+    }
+
+    void expect(char c) {
+        if (peek() != c) {
+            fail("unexpected character");
+        }
+        ++pos_;
+    }
+
+    void expect_word(std::string_view word) {
+        if (source_.substr(pos_, word.size()) != word) {
+            fail("invalid literal");
+        }
+        pos_ += word.size();
+    }
+
+    json_value parse_value(size_t depth) {
+        if (depth > max_depth) {
+            fail("nesting too deep");
+        }
+        switch (peek()) {
+        case '{': return parse_object(depth);
+        case '[': return parse_array(depth);
+        case '"': return parse_text();
+        case 't': expect_word("true"); return true;
+        case 'f': expect_word("false"); return false;
+        case 'n': expect_word("null"); return nullptr;
+        default: return parse_number();
+        }
+    }
+
+    // elements are collected on a shared stack and copied to the arena once their number is known.
+    json_value parse_array(size_t depth) {
+        expect('[');
+        auto first = values_.size();
+        skip_space();
+        if (peek() != ']') {
+            while (true) {
+                skip_space();
+                values_.push_back(parse_value(depth + 1));
+                skip_space();
+                if (peek() != ',') {
+                    break;
+                }
+                ++pos_;
+            }
+        }
+        expect(']');
+        auto count = values_.size() - first;
+        auto values = arena_.allocate<json_value>(count);
+        std::uninitialized_copy(values_.begin() + first, values_.end(), values);
+        values_.resize(first);
+        return json_array{values, count};
+    }
+
+    json_value parse_object(size_t depth) {
+        expect('{');
+        auto first = members_.size();
+        skip_space();
+        if (peek() != '}') {
+            while (true) {
+                skip_space();
+                if (peek() != '"') {
+                    fail("expected a member name");
+                }
+                auto key = parse_text();
+                skip_space();
+                expect(':');
+                skip_space();
+                auto value = parse_value(depth + 1);
+                members_.push_back(json_member{key, easymatch_impl::fnv1a(key), value});
+                skip_space();
+                if (peek() != ',') {
+                    break;
+                }
+                ++pos_;
+            }
+        }
+        expect('}');
+        auto count = members_.size() - first;
+        auto members = arena_.allocate<json_member>(count);
+        std::uninitialized_copy(members_.begin() + first, members_.end(), members);
+        members_.resize(first);
+        return json_object{members, count};
+    }
+
+    std::string_view parse_text() {
+        expect('"');
+        auto begin = pos_;
+        while (!at_end() && peek() != '"' && peek() != '\\') {
+            ++pos_;
+        }
+        if (peek() == '"') {
+            ++pos_;
+            return source_.substr(begin, pos_ - begin - 1);
+        }
+        return decode_text(begin);
+    }
+
+    // strings with escapes are decoded into the arena; the result is never longer than the source.
+    std::string_view decode_text(size_t begin) {
+        auto end = source_.find('"', pos_);
+        while (end != std::string_view::npos && is_escaped(end, begin)) {
+            end = source_.find('"', end + 1);
+        }
+        if (end == std::string_view::npos) {
+            fail("unterminated string");
+        }
+        auto out = arena_.allocate<char>(end - begin);
+        size_t size = pos_ - begin;
+        std::memcpy(out, source_.data() + begin, size);
+        while (pos_ < end) {
+            auto c = source_[pos_++];
+            if (c != '\\') {
+                out[size++] = c;
+                continue;
+            }
+            switch (source_[pos_++]) {
+            case '"': out[size++] = '"'; break;
+            case '\\': out[size++] = '\\'; break;
+            case '/': out[size++] = '/'; break;
+            case 'b': out[size++] = '\b'; break;
+            case 'f': out[size++] = '\f'; break;
+            case 'n': out[size++] = '\n'; break;
+            case 'r': out[size++] = '\r'; break;
+            case 't': out[size++] = '\t'; break;
+            case 'u': size += decode_unicode(out + size, end); break;
+            default: fail("invalid escape");
+            }
+        }
+        pos_ = end + 1;
+        return std::string_view(out, size);
+    }
+
+    bool is_escaped(size_t quote, size_t begin) const {
+        size_t backslashes = 0;
+        while (quote - backslashes > begin && source_[quote - backslashes - 1] == '\\') {
+            ++backslashes;
+        }
+        return backslashes % 2 == 1;
+    }
+
+    uint32_t parse_hex4(size_t end) {
+        if (end - pos_ < 4) {
+            fail("invalid unicode escape");
+        }
+        uint32_t code = 0;
+        auto result = std::from_chars(source_.data() + pos_, source_.data() + pos_ + 4, code, 16);
+        if (result.ptr != source_.data() + pos_ + 4) {
+            fail("invalid unicode escape");
+        }
+        pos_ += 4;
+        return code;
+    }
+
+    // writes the code point as UTF-8, which is at most as long as its escape.
+    size_t decode_unicode(char* out, size_t end) {
+        auto code = parse_hex4(end);
+        if (code >= 0xD800 && code < 0xDC00 && source_.substr(pos_, 2) == "\\u") {
+            pos_ += 2;
+            auto low = parse_hex4(end);
+            if (low < 0xDC00 || low >= 0xE000) {
+                fail("invalid surrogate pair");
+            }
+            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+        }
+        if (code < 0x80) {
+            out[0] = static_cast<char>(code);
+            return 1;
+        }
+        if (code < 0x800) {
+            out[0] = static_cast<char>(0xC0 | (code >> 6));
+            out[1] = static_cast<char>(0x80 | (code & 0x3F));
+            return 2;
+        }
+        if (code < 0x10000) {
+            out[0] = static_cast<char>(0xE0 | (code >> 12));
+            out[1] = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out[2] = static_cast<char>(0x80 | (code & 0x3F));
+            return 3;
+        }
+        out[0] = static_cast<char>(0xF0 | (code >> 18));
+        out[1] = static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+        out[2] = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out[3] = static_cast<char>(0x80 | (code & 0x3F));
+        return 4;
+    }
+
+    json_value parse_number() {
+        auto begin = pos_;
+        while (!at_end() && std::string_view("+-0123456789.eE").find(peek()) != std::string_view::npos) {
+            ++pos_;
+        }
+        double number = 0;
+        auto first = source_.data() + begin;
+        auto last = source_.data() + pos_;
+        auto result = std::from_chars(first, last, number);
+        if (begin == pos_ || result.ec != std::errc() || result.ptr != last) {
+            pos_ = begin;
+            fail("invalid value");
+        }
+        return number;
+    }
+
+    std::string_view source_;
+    size_t pos_ = 0;
+    easymatch_impl::document_arena arena_;
+    std::vector<json_value> values_;
+    std::vector<json_member> members_;
+    json_value root_;
+};
+
+namespace easymatch_impl {
+
+template<typename... Patterns, size_t... Is>
+auto arr_unwrap_fn(const json_array& array, std::index_sequence<Is...>, const Patterns&... patterns) {
+    return std::tuple<decltype(ds_unwrap(array[Is], patterns))...>{ds_unwrap(array[Is], patterns)...};
+}
+
+}  // namespace easymatch_impl
+
+/*
+ * obj(key(k, pattern)...) matches an object whose members match every key pattern.
+ * The handler receives the matched member values in order.
+ */
+template<typename... Patterns>
+auto obj(const Patterns&... patterns) {
+    auto match_fn = [=](auto&& x) {
+        return std::holds_alternative<json_object>(x) && (easymatch_impl::ds_match(x, patterns) && ...);
+    };
+    auto unwrap_fn = [=](auto&& x) {
+        return std::tuple<decltype(easymatch_impl::ds_unwrap(x, patterns))...>{
+            easymatch_impl::ds_unwrap(x, patterns)...};
+    };
+    return easymatch_impl::Pattern<decltype(match_fn), decltype(unwrap_fn)> {
+        std::move(match_fn),
+        std::move(unwrap_fn)
+    };
+}
+
+/* arr(patterns...) matches an array with one element per pattern. */
+template<typename... Patterns>
+auto arr(const Patterns&... patterns) {
+    auto match_fn = [=](auto&& x) {
+        auto array = std::get_if<json_array>(&x);
+        if (array == nullptr || array->size() != sizeof...(Patterns)) {
+            return false;
+        }
+        size_t i = 0;
+        return (easymatch_impl::ds_match((*array)[i++], patterns) && ...);
+    };
+    auto unwrap_fn = [=](auto&& x) {
+        return easymatch_impl::arr_unwrap_fn(
+            std::get<json_array>(x), std::index_sequence_for<Patterns...>{}, patterns...);
+    };
+    return easymatch_impl::Pattern<decltype(match_fn), decltype(unwrap_fn)> {
+        std::move(match_fn),
+        std::move(unwrap_fn)
+    };
+}
+
+}  // namespace easymatch
+
+#endif  // EASY_MATCH_DOCUMENT_HPP_
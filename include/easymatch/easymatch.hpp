@@ -6,12 +6,29 @@
 #ifndef EASY_MATCH_HPP_
 #define EASY_MATCH_HPP_
 
+#include <algorithm>
 #include <any>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
 #include <optional>
 #include <stdexcept>
+#include <string>
+#include <string_view>
 #include <tuple>
 #include <type_traits>
 #include <variant>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 namespace easymatch {
 
@@ -22,11 +39,14 @@ namespace easymatch_impl {
 template <typename T>
 using remove_cvref_t = std::remove_cv_t<std::remove_reference_t<T>>;
 
-template<typename T>
-inline constexpr bool is_variant_v = false;
-
 template<typename... Args>
-inline constexpr bool is_variant_v<std::variant<Args...>> = true;
+std::true_type variant_base_test(const std::variant<Args...>*);
+
+std::false_type variant_base_test(...);
+
+/* true for std::variant and classes derived from it */
+template<typename T>
+inline constexpr bool is_variant_v = decltype(variant_base_test(std::declval<T*>()))::value;
 
 template<typename T>
 inline constexpr bool is_tuple_v = false;
@@ -46,14 +66,39 @@ inline constexpr auto has_operator_call_v = has_operator_call<F>::value;
 template <typename T>
 inline constexpr bool is_any_v = std::is_same_v<std::any, T>;
 
-inline constexpr auto identity = [](auto&& x) {
-    return x;
+inline constexpr auto identity = [](auto&& x) -> decltype(auto) {
+    return std::forward<decltype(x)>(x);
+};
+
+/*
+ * An unwrap returns a reference into its argument with the argument's value category,
+ * or a value it made. owned_t<T> is what owns the result: T by value, and tuples of
+ * references as tuples of values.
+ */
+template<typename T>
+struct owned {
+    using type = T;
 };
 
+template<typename... Ts>
+struct owned<std::tuple<Ts...>> {
+    using type = std::tuple<typename owned<remove_cvref_t<Ts>>::type...>;
+};
+
+template<typename T>
+using owned_t = typename owned<remove_cvref_t<T>>::type;
+
+/* conditions known at compile time return std::true_type or std::false_type */
 inline constexpr auto pass = [](auto&&) {
-    return true;
+    return std::true_type{};
 };
 
+template<typename Condition>
+inline constexpr bool is_always_true_v = std::is_same_v<Condition, std::true_type>;
+
+template<typename Condition>
+inline constexpr bool is_always_false_v = std::is_same_v<Condition, std::false_type>;
+
 /* types */
 
 struct PatternStarter {};
@@ -133,22 +178,36 @@ inline constexpr auto pattern = PatternStarter{};
 /* patterns */
 
 template <typename T>
-inline constexpr auto as_match_fn = [](auto&& x) {
-    if constexpr (is_variant_v<remove_cvref_t<decltype(x)>>) {
-        return std::holds_alternative<T>(x);
-    }
-    if constexpr (is_any_v<remove_cvref_t<decltype(x)>>) {
-        return x.type() == typeid(T);
+struct as_condition {
+    template<typename X>
+    constexpr auto operator()(X&& x) const {
+        if constexpr (is_variant_v<remove_cvref_t<X>>) {
+            return std::holds_alternative<T>(x);
+        } else if constexpr (is_any_v<remove_cvref_t<X>>) {
+            return x.type() == typeid(T);
+        } else {
+            // a plain value is statically known to be or not to be a T.
+            return std::bool_constant<std::is_same_v<remove_cvref_t<X>, T>>{};
+        }
     }
 };
 
 template <typename T>
-inline constexpr auto as_unwrap_fn = [](auto&& x) {
+inline constexpr auto as_match_fn = as_condition<T>{};
+
+// the held value is passed by reference, and moved out of an rvalue.
+template <typename T>
+inline constexpr auto as_unwrap_fn = [](auto&& x) -> decltype(auto) {
     if constexpr (is_variant_v<remove_cvref_t<decltype(x)>>) {
         return std::get<T>(std::forward<decltype(x)>(x));
-    }
-    if constexpr (is_any_v<remove_cvref_t<decltype(x)>>) {
-        return std::any_cast<T>(std::forward<decltype(x)>(x));
+    } else if constexpr (is_any_v<remove_cvref_t<decltype(x)>>) {
+        if constexpr (std::is_lvalue_reference_v<decltype(x)>) {
+            return *std::any_cast<T>(&x);
+        } else {
+            return std::move(*std::any_cast<T>(&x));
+        }
+    } else {
+        return std::forward<decltype(x)>(x);
     }
 };
 
@@ -162,7 +221,7 @@ inline constexpr auto some_match_fn = [](auto&& x) {
     return x.has_value();
 };
 
-inline constexpr auto some_unwrap_fn = [](auto&& x) {
+inline constexpr auto some_unwrap_fn = [](auto&& x) -> decltype(auto) {
     return *std::forward<decltype(x)>(x);
 };
 
@@ -184,20 +243,31 @@ inline constexpr auto none = Pattern<decltype(none_match_fn), decltype(none_unwr
     none_unwrap_fn
 };
 
+/* a guard function, or a value compared with == */
+template <typename Condition>
+struct guard_condition {
+    Condition cond;
+
+    template<typename X>
+    constexpr auto operator()(X&& x) const {
+        if constexpr (std::is_invocable_v<const Condition&, X&>) {
+            return cond(x);
+        } else {
+            return cond == x;
+        }
+    }
+};
+
 template <typename Condition>
 constexpr auto when(const Condition& cond) {
     if constexpr (is_pattern_v<Condition> || is_wildcard_v<Condition>) {
         return cond;
     } else {
-        auto match_fn = [=](auto&& x) {
-            if constexpr (std::is_invocable_v<Condition, decltype(x)>) {
-                return cond(x);
-            } else {
-                return cond == x;
-            }
-        };
-        return Pattern<decltype(match_fn), decltype(identity)> {
-            std::move(match_fn),
+        using Stored = std::conditional_t<std::is_array_v<Condition> || std::is_function_v<Condition>,
+                                          std::decay_t<const Condition&>, Condition>;
+        using Guard = guard_condition<Stored>;
+        return Pattern<Guard, decltype(identity)> {
+            Guard{cond},
             identity
         };
     }
@@ -222,10 +292,21 @@ template<typename PatternLhs, typename PatternRhs, std::enable_if_t<is_pattern_v
 constexpr auto operator | (const PatternLhs& lhs, const PatternRhs& rhs) {
     if constexpr (is_pattern_v<PatternRhs>) {
         auto match_fn = [=](auto&& x) {
-            return lhs.condition(x) && rhs.condition(lhs.unwrap(x));
+            if constexpr (is_always_false_v<decltype(lhs.condition(x))>) {
+                return std::false_type{};
+            } else {
+                return lhs.condition(x) && rhs.condition(lhs.unwrap(x));
+            }
         };
-        auto unwrap_fn = [=](auto&& x) {
-            return rhs.unwrap(lhs.unwrap(std::forward<decltype(x)>(x)));
+        // a result of rhs may refer into a temporary made by lhs, so it is then returned by value.
+        auto unwrap_fn = [=](auto&& x) -> decltype(auto) {
+            using Inner = decltype(lhs.unwrap(std::forward<decltype(x)>(x)));
+            if constexpr (std::is_reference_v<Inner>) {
+                return rhs.unwrap(lhs.unwrap(std::forward<decltype(x)>(x)));
+            } else {
+                using Outer = decltype(rhs.unwrap(std::declval<Inner>()));
+                return owned_t<Outer>(rhs.unwrap(lhs.unwrap(std::forward<decltype(x)>(x))));
+            }
         };
         return Pattern<decltype(match_fn), decltype(unwrap_fn)> {std::move(match_fn), std::move(unwrap_fn)};
     } else if constexpr (is_wildcard_v<PatternRhs>) {
@@ -237,30 +318,103 @@ constexpr auto operator | (const PatternLhs& lhs, const PatternRhs& rhs) {
 
 /* Wildcard <op> x -> Pattern */
 
-#define MAKE_PATTERN_WITH_WILDCARD(op)                       \
-template<typename T>                                         \
-constexpr auto operator op (const Wildcard&, const T& t) {   \
-    auto comp = [=](auto&& x) { return x op t; };            \
-    return Pattern<decltype(comp), decltype(identity)> {     \
-        std::move(comp),                                     \
-        identity                                             \
-    };                                                       \
-}                                                            \
-template<typename T>                                         \
-constexpr auto operator op (const T& t, const Wildcard&) {   \
-    auto comp = [=](auto&& x) { return t op x; };            \
-    return Pattern<decltype(comp), decltype(identity)> {     \
-        std::move(comp),                                     \
-        identity                                             \
-    };                                                       \
-}
-
-MAKE_PATTERN_WITH_WILDCARD(==)
-MAKE_PATTERN_WITH_WILDCARD(!=)
-MAKE_PATTERN_WITH_WILDCARD(<)
-MAKE_PATTERN_WITH_WILDCARD(>)
-MAKE_PATTERN_WITH_WILDCARD(>=)
-MAKE_PATTERN_WITH_WILDCARD(<=)
+/* comparison conditions are named types, so that combinators can invert and merge them. */
+template<typename Op, typename T>
+struct comparison_condition {
+    T value;
+
+    template<typename X>
+    constexpr auto operator()(X&& x) const {
+        return Op{}(std::forward<X>(x), value);
+    }
+};
+
+template<typename T>
+inline constexpr bool is_comparison_condition_v = false;
+
+template<typename Op, typename T>
+inline constexpr bool is_comparison_condition_v<comparison_condition<Op, T>> = true;
+
+/* x op t, written as t op x */
+template<typename Op> struct mirrored_comparison { using type = Op; };
+template<> struct mirrored_comparison<std::less<>> { using type = std::greater<>; };
+template<> struct mirrored_comparison<std::greater<>> { using type = std::less<>; };
+template<> struct mirrored_comparison<std::less_equal<>> { using type = std::greater_equal<>; };
+template<> struct mirrored_comparison<std::greater_equal<>> { using type = std::less_equal<>; };
+
+/* reversed<Op> is t op x for a pattern written as t op _, keeping the operand order of the user's operator. */
+template<typename Op>
+struct reversed {
+    template<typename L, typename R>
+    constexpr auto operator()(L&& x, R&& t) const {
+        return Op{}(std::forward<R>(t), std::forward<L>(x));
+    }
+};
+
+/* the operator of x op t that a comparison means for arithmetic operands */
+template<typename Op> struct canonical_comparison { using type = Op; };
+template<typename Op> struct canonical_comparison<reversed<Op>> { using type = typename mirrored_comparison<Op>::type; };
+
+/* !(x op t) under a total order */
+template<typename Op> struct inverted_comparison;
+template<> struct inverted_comparison<std::equal_to<>> { using type = std::not_equal_to<>; };
+template<> struct inverted_comparison<std::not_equal_to<>> { using type = std::equal_to<>; };
+template<> struct inverted_comparison<std::less<>> { using type = std::greater_equal<>; };
+template<> struct inverted_comparison<std::greater_equal<>> { using type = std::less<>; };
+template<> struct inverted_comparison<std::greater<>> { using type = std::less_equal<>; };
+template<> struct inverted_comparison<std::less_equal<>> { using type = std::greater<>; };
+template<typename Op> struct inverted_comparison<reversed<Op>> {
+    using type = reversed<typename inverted_comparison<Op>::type>;
+};
+
+/* integers and enumerations are totally ordered and have every comparison operator. */
+template<typename T>
+inline constexpr bool is_totally_ordered_v = std::is_integral_v<T> || std::is_enum_v<T>;
+
+/*
+ * negated<Op> is !(x op t). It uses the inverted operator only when both operands are
+ * totally ordered, which is known once the subject's type is: !(NaN < 1) holds, but NaN >= 1
+ * does not, and a user type may define < without >=.
+ */
+template<typename Op>
+struct negated {
+    template<typename L, typename R>
+    constexpr bool operator()(const L& lhs, const R& rhs) const {
+        if constexpr (is_totally_ordered_v<L> && is_totally_ordered_v<R>) {
+            return typename inverted_comparison<Op>::type{}(lhs, rhs);
+        } else {
+            return !static_cast<bool>(Op{}(lhs, rhs));
+        }
+    }
+};
+
+template<typename Op> struct negated_comparison { using type = negated<Op>; };
+template<typename Op> struct negated_comparison<negated<Op>> { using type = Op; };
+
+template<typename Op, typename T>
+constexpr auto comparison_pattern(const T& t) {
+    return Pattern<comparison_condition<Op, std::decay_t<T>>, decltype(identity)> {
+        comparison_condition<Op, std::decay_t<T>>{t},
+        identity
+    };
+}
+
+#define MAKE_PATTERN_WITH_WILDCARD(op, Op)                                  \
+template<typename T>                                                        \
+constexpr auto operator op (const Wildcard&, const T& t) {                  \
+    return comparison_pattern<Op>(t);                                       \
+}                                                                           \
+template<typename T>                                                        \
+constexpr auto operator op (const T& t, const Wildcard&) {                  \
+    return comparison_pattern<reversed<Op>>(t);                             \
+}
+
+MAKE_PATTERN_WITH_WILDCARD(==, std::equal_to<>)
+MAKE_PATTERN_WITH_WILDCARD(!=, std::not_equal_to<>)
+MAKE_PATTERN_WITH_WILDCARD(<, std::less<>)
+MAKE_PATTERN_WITH_WILDCARD(>, std::greater<>)
+MAKE_PATTERN_WITH_WILDCARD(>=, std::greater_equal<>)
+MAKE_PATTERN_WITH_WILDCARD(<=, std::less_equal<>)
 
 #undef MAKE_PATTERN_WITH_WILDCARD
 
@@ -293,9 +447,22 @@ constexpr auto ds_match_fn(Value&& x, std::index_sequence<Is...>, const Patterns
     return (ds_match(std::get<Is>(x), patterns) && ...);
 }
 
+// unlike ds_unwrap, passes a column on with its value category instead of copying it.
+template<typename Value, typename PatternT>
+constexpr decltype(auto) ds_forward(Value&& x, const PatternT& pattern) {
+    if constexpr (is_pattern_v<PatternT>) {
+        return pattern.unwrap(std::forward<Value>(x));
+    } else {
+        return std::forward<Value>(x);
+    }
+}
+
+// the columns refer into x, which outlives the call of the handler.
 template<typename Value, typename... Patterns, size_t... Is>
 constexpr auto ds_unwrap_fn(Value&& x, std::index_sequence<Is...>, const Patterns&... patterns) {
-    return std::make_tuple(ds_unwrap(std::get<Is>(x), patterns)...);
+    return std::tuple<decltype(ds_forward(std::get<Is>(std::forward<Value>(x)), patterns))...> {
+        ds_forward(std::get<Is>(std::forward<Value>(x)), patterns)...
+    };
 }
 
 template<typename... Patterns>
@@ -304,7 +471,7 @@ constexpr auto ds(const Patterns&... patterns) {
         return ds_match_fn(packed_x, std::index_sequence_for<Patterns...>{}, patterns...);
     };
     auto unwrap_fn = [=](auto&& packed_x) {
-        return ds_unwrap_fn(packed_x, std::index_sequence_for<Patterns...>{}, patterns...);
+        return ds_unwrap_fn(std::forward<decltype(packed_x)>(packed_x), std::index_sequence_for<Patterns...>{}, patterns...);
     };
     return Pattern<decltype(match_fn), decltype(unwrap_fn)> {
         std::move(match_fn),
@@ -312,45 +479,1526 @@ constexpr auto ds(const Patterns&... patterns) {
     };
 }
 
-/* match */
+/* split(sep, Patterns...) / fields(sep, Patterns...) -> Pattern */
 
-template<typename Value, typename PatternStatementT>
-constexpr auto match_impl(Value&& x, const PatternStatementT& ps) {
-    if (!ps.condition(x)) {
-        throw std::runtime_error("unmatched to all cases");
+template<typename Separator>
+class field_cursor {
+public:
+    constexpr field_cursor(std::string_view text, Separator separator)
+        : rest_(text), separator_(separator) {}
+
+    /* slices the next field; returns false after the last field. */
+    constexpr bool next(std::string_view& field) {
+        if (done_) {
+            return false;
+        }
+        auto pos = separator_size() == 0 ? std::string_view::npos : rest_.find(separator_);
+        if (pos == std::string_view::npos) {
+            field = rest_;
+            done_ = true;
+        } else {
+            field = rest_.substr(0, pos);
+            rest_.remove_prefix(pos + separator_size());
+        }
+        return true;
+    }
+
+    constexpr bool done() const {
+        return done_;
+    }
+
+private:
+    constexpr size_t separator_size() const {
+        if constexpr (std::is_same_v<Separator, char>) {
+            return 1;
+        } else {
+            return separator_.size();
+        }
     }
-    return ps.handler(ps.unwrap(std::forward<Value>(x)));
+
+    std::string_view rest_;
+    Separator separator_;
+    bool done_ = false;
+};
+
+template<typename Separator>
+constexpr auto make_field_cursor(std::string_view text, const Separator& separator) {
+    if constexpr (std::is_same_v<Separator, char>) {
+        return field_cursor<char>(text, separator);
+    } else {
+        return field_cursor<std::string_view>(text, std::string_view(separator));
+    }
+}
+
+template<typename Cursor, typename PatternT>
+constexpr bool split_match(Cursor& cursor, const PatternT& pattern) {
+    std::string_view field;
+    return cursor.next(field) && ds_match(field, pattern);
+}
+
+template<typename Cursor, typename PatternT>
+constexpr auto split_unwrap(Cursor& cursor, const PatternT& pattern) {
+    std::string_view field;
+    cursor.next(field);
+    return ds_unwrap(field, pattern);
+}
+
+// Fields are sliced lazily and tested as soon as they are produced, so the first
+// mismatching field ends the test. Exact requires that no field is left over.
+template<bool Exact, typename Separator, typename... Patterns>
+constexpr auto split_pattern(const Separator& separator, const Patterns&... patterns) {
+    auto match_fn = [=](auto&& x) {
+        auto cursor = make_field_cursor(std::string_view(x), separator);
+        return (split_match(cursor, patterns) && ...) && (!Exact || cursor.done());
+    };
+    auto unwrap_fn = [=](auto&& x) {
+        auto cursor = make_field_cursor(std::string_view(x), separator);
+        // braced initialization keeps the fields in order.
+        return std::tuple<decltype(ds_unwrap(std::string_view(), patterns))...> {
+            split_unwrap(cursor, patterns)...
+        };
+    };
+    return Pattern<decltype(match_fn), decltype(unwrap_fn)> {
+        std::move(match_fn),
+        std::move(unwrap_fn)
+    };
+}
+
+/* split(sep, p1, ..., pN) matches text with exactly N fields. */
+template<typename Separator, typename... Patterns>
+constexpr auto split(const Separator& separator, const Patterns&... patterns) {
+    return split_pattern<true>(separator, patterns...);
+}
+
+/* fields(sep, p1, ..., pN) matches text with at least N fields, ignoring the rest. */
+template<typename Separator, typename... Patterns>
+constexpr auto fields(const Separator& separator, const Patterns&... patterns) {
+    return split_pattern<false>(separator, patterns...);
+}
+
+/* parse<T>(Pattern) -> Pattern */
+
+/* parses the whole text as a T in place; never throws. */
+template<typename T>
+bool parse_value(std::string_view text, T& value) {
+    static_assert(std::is_arithmetic_v<T> && !std::is_same_v<T, bool>, "parse<T> requires a number type");
+    auto last = text.data() + text.size();
+    auto [ptr, ec] = std::from_chars(text.data(), last, value);
+    return ec == std::errc() && ptr == last;
 }
 
-template<typename Value, typename PatternStatementT, typename... RestPatternStatements>
-constexpr auto match_impl(Value&& x, const PatternStatementT& ps, const RestPatternStatements&... rests) {
-    if (ps.condition(x)) {
-        return ps.handler(ps.unwrap(std::forward<Value>(x)));
+/*
+ * parse_memo remembers the last few texts that parse<T> conditions parsed on this
+ * thread, so the unwrap of the matched arm reuses the value instead of parsing again.
+ * Texts are told apart by address and size; a miss parses again.
+ */
+template<typename T>
+class parse_memo {
+public:
+    void remember(std::string_view text, T value) {
+        entries_[next_ % entries_.size()] = {text.data(), text.size(), value};
+        ++next_;
+    }
+
+    /* the most recent value parsed from text, or false if it is no longer remembered. */
+    bool recall(std::string_view text, T& value) const {
+        for (size_t i = 0; i < entries_.size() && i < next_; ++i) {
+            const auto& entry = entries_[(next_ - 1 - i) % entries_.size()];
+            if (entry.data == text.data() && entry.size == text.size()) {
+                value = entry.value;
+                return true;
+            }
+        }
+        return false;
     }
-    return match_impl(std::forward<Value>(x), rests...);
+
+private:
+    struct entry {
+        const char* data;
+        size_t size;
+        T value;
+    };
+
+    // enough for the parse<T> fields of one split() or ds().
+    std::array<entry, 4> entries_{};
+    size_t next_ = 0;
+};
+
+template<typename T>
+inline thread_local parse_memo<T> recent_parses;
+
+template<typename T, typename PatternT = Wildcard>
+constexpr auto parse(const PatternT& inner = _) {
+    auto match_fn = [=](auto&& x) {
+        auto text = std::string_view(x);
+        T value{};
+        if (!parse_value(text, value)) {
+            return false;
+        }
+        recent_parses<T>.remember(text, value);
+        return static_cast<bool>(ds_match(value, inner));
+    };
+    auto unwrap_fn = [=](auto&& x) {
+        auto text = std::string_view(x);
+        T value{};
+        if (!recent_parses<T>.recall(text, value)) {
+            parse_value(text, value);
+        }
+        return ds_unwrap(value, inner);
+    };
+    return Pattern<decltype(match_fn), decltype(unwrap_fn)> {
+        std::move(match_fn),
+        std::move(unwrap_fn)
+    };
 }
 
-}  // namespace easymatch_impl
+/* key(k, Pattern) / has_key(k) -> Pattern */
 
-using easymatch_impl::as;
-using easymatch_impl::some;
-using easymatch_impl::none;
-using easymatch_impl::when;
-using easymatch_impl::_;
-using easymatch_impl::pattern;
-using easymatch_impl::ds;
+template<typename T>
+inline constexpr bool is_string_like_v = std::is_convertible_v<const T&, std::string_view>;
+
+template<typename Compare, typename = void>
+struct is_transparent : std::false_type {};
+
+template<typename Compare>
+struct is_transparent<Compare, std::void_t<typename Compare::is_transparent>> : std::true_type {};
+
+/*
+ * string keys are hashed once when a pattern is built. Only json_document objects use the
+ * hash; standard maps, std::unordered_map included, still hash or compare the key text.
+ */
+constexpr size_t fnv1a(std::string_view text) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (auto c : text) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+    }
+    return static_cast<size_t>(hash);
+}
+
+struct hashed_key {
+    std::string_view text;
+    size_t hash;
+};
+
+template<typename Key>
+constexpr auto make_lookup_key(const Key& key) {
+    if constexpr (is_string_like_v<Key>) {
+        auto text = std::string_view(key);
+        return hashed_key{text, fnv1a(text)};
+    } else {
+        return key;
+    }
+}
+
+template<typename Key>
+constexpr const Key& plain_key(const Key& key) {
+    return key;
+}
+
+constexpr std::string_view plain_key(const hashed_key& key) {
+    return key.text;
+}
+
+template<typename Map, typename = void>
+struct has_transparent_compare : std::false_type {};
+
+template<typename Map>
+struct has_transparent_compare<Map, std::void_t<typename Map::key_compare>>
+    : is_transparent<typename Map::key_compare> {};
+
+/* returns a pointer to the mapped value, or nullptr. */
+template<typename Map, typename Key>
+auto find_mapped(Map& map, const Key& key) {
+    using Mapped = std::remove_reference_t<decltype(map.find(std::declval<typename Map::key_type>())->second)>;
+    const auto& k = plain_key(key);
+    auto it = [&] {
+        if constexpr (has_transparent_compare<remove_cvref_t<Map>>::value
+                      || std::is_same_v<remove_cvref_t<decltype(k)>, typename Map::key_type>) {
+            return map.find(k);
+        } else {
+            return map.find(typename Map::key_type(k));
+        }
+    }();
+    return it == map.end() ? static_cast<Mapped*>(nullptr) : &it->second;
+}
+
+/*
+ * lookup_view remembers the results of key lookups on a map during one match call,
+ * so arms that query the same key share one lookup.
+ */
+template<typename Map>
+class lookup_view {
+public:
+    using key_type = typename Map::key_type;
+    using cache_key_type = std::conditional_t<is_string_like_v<key_type>, std::string_view, key_type>;
+    using mapped_pointer = decltype(find_mapped(std::declval<Map&>(), std::declval<const key_type&>()));
+
+    explicit lookup_view(Map& map) : map_(map) {}
+
+    Map& map() const {
+        return map_;
+    }
+
+    template<typename Key>
+    mapped_pointer find(const Key& key) const {
+        auto cache_key = cache_key_type(plain_key(key));
+        for (size_t i = 0; i < size_; ++i) {
+            if (cache_[i].first == cache_key) {
+                return cache_[i].second;
+            }
+        }
+        auto found = find_mapped(map_, key);
+        if (size_ < cache_.size()) {
+            cache_[size_++] = {cache_key, found};
+        }
+        return found;
+    }
+
+private:
+    static constexpr size_t cache_size = 8;
+
+    Map& map_;
+    mutable std::array<std::pair<cache_key_type, mapped_pointer>, cache_size> cache_{};
+    mutable size_t size_ = 0;
+};
 
 template<typename T>
-constexpr auto match(T&& x) {
-    return [&](auto&&... args) {
-        return easymatch_impl::match_impl(std::forward<decltype(x)>(x), std::forward<decltype(args)>(args)...);
+inline constexpr bool is_lookup_view_v = false;
+
+template<typename Map>
+inline constexpr bool is_lookup_view_v<lookup_view<Map>> = true;
+
+/* maps whose keys lookup_view can remember. */
+template<typename T, typename = void>
+inline constexpr bool is_map_like_v = false;
+
+template<typename T>
+inline constexpr bool is_map_like_v<T, std::void_t<typename T::mapped_type,
+        decltype(std::declval<const typename T::key_type&>() == std::declval<const typename T::key_type&>())>>
+    = std::is_default_constructible_v<typename T::key_type>;
+
+/* the lookup_view of the match call running on a map of this type, if any. */
+template<typename Map>
+inline thread_local lookup_view<Map>* current_lookup = nullptr;
+
+/*
+ * lookup_scope shares the lookups of key() and has_key() between the arms of a match
+ * on a plain map. It is closed before the handler runs, which may modify the map.
+ */
+template<typename Map>
+class lookup_scope {
+public:
+    explicit lookup_scope(const Map& map)
+        : view_(const_cast<Map&>(map)), previous_(current_lookup<Map>) {
+        current_lookup<Map> = &view_;
+    }
+
+    lookup_scope(const lookup_scope&) = delete;
+    lookup_scope& operator=(const lookup_scope&) = delete;
+
+    ~lookup_scope() {
+        close();
+    }
+
+    void close() {
+        if (open_) {
+            current_lookup<Map> = previous_;
+            open_ = false;
+        }
+    }
+
+private:
+    lookup_view<Map> view_;
+    lookup_view<Map>* previous_;
+    bool open_ = true;
+};
+
+template<typename Source, typename Key>
+auto lookup_mapped(Source& x, const Key& key) {
+    using Map = remove_cvref_t<Source>;
+    if constexpr (is_lookup_view_v<Map>) {
+        return x.find(key);
+    } else if constexpr (is_map_like_v<Map>) {
+        using mapped_pointer = decltype(find_mapped(x, key));
+        auto view = current_lookup<Map>;
+        if (view != nullptr && &view->map() == &x) {
+            return static_cast<mapped_pointer>(view->find(key));
+        }
+        return find_mapped(x, key);
+    } else {
+        return find_mapped(x, key);
+    }
+}
+
+template<typename Key, typename PatternT = Wildcard>
+constexpr auto key(const Key& key_value, const PatternT& inner = _) {
+    auto k = make_lookup_key(key_value);
+    auto match_fn = [=](auto&& x) {
+        auto mapped = lookup_mapped(x, k);
+        return mapped != nullptr && ds_match(*mapped, inner);
+    };
+    // the mapped value is passed by reference unless the inner pattern transforms it.
+    auto unwrap_fn = [=](auto&& x) -> decltype(auto) {
+        auto& mapped = *lookup_mapped(x, k);
+        if constexpr (is_pattern_v<PatternT>) {
+            return inner.unwrap(mapped);
+        } else {
+            return (mapped);
+        }
+    };
+    return Pattern<decltype(match_fn), decltype(unwrap_fn)> {
+        std::move(match_fn),
+        std::move(unwrap_fn)
     };
 }
 
-template<typename... Args>
-constexpr auto match(Args&&... x) {
-    return [&](auto&&... args) {
-        return easymatch_impl::match_impl(std::forward_as_tuple(x...), std::forward<decltype(args)>(args)...);
+template<typename Key>
+constexpr auto has_key(const Key& key_value) {
+    auto k = make_lookup_key(key_value);
+    auto match_fn = [=](auto&& x) {
+        return lookup_mapped(x, k) != nullptr;
+    };
+    return Pattern<decltype(match_fn), decltype(identity)> {
+        std::move(match_fn),
+        identity
+    };
+}
+
+/* deref(Pattern) -> Pattern */
+
+/* matches a non-null pointer or smart pointer whose pointee matches inner. */
+template<typename PatternT>
+struct deref_condition {
+    PatternT inner;
+
+    template<typename X>
+    constexpr bool operator()(X&& x) const {
+        return x != nullptr && ds_match(*x, inner);
+    }
+};
+
+template<typename PatternT = Wildcard>
+constexpr auto deref(const PatternT& inner = _) {
+    auto match_fn = deref_condition<PatternT>{inner};
+    auto unwrap_fn = [=](auto&& x) -> decltype(auto) {
+        if constexpr (is_pattern_v<PatternT>) {
+            return inner.unwrap(*x);
+        } else {
+            return *x;
+        }
+    };
+    return Pattern<decltype(match_fn), decltype(unwrap_fn)> {
+        std::move(match_fn),
+        std::move(unwrap_fn)
+    };
+}
+
+/* one_of(values...) / one_of(range) -> Pattern */
+
+template<typename T>
+using set_value_t = std::conditional_t<std::is_same_v<std::decay_t<T>, const char*> || std::is_same_v<std::decay_t<T>, char*>,
+                                       std::string_view, std::decay_t<T>>;
+
+template<typename T>
+using set_lookup_t = std::conditional_t<is_string_like_v<T>, std::string_view, T>;
+
+/*
+ * true when the number x converts to T without change, so it is looked up as T(x);
+ * 3.5 or -1 never match a set of ints, and 2^32 + 1 never matches a set of 32-bit ints.
+ * Values of other types are converted as they are.
+ */
+template<typename T, typename U>
+constexpr bool exactly_representable(const U& x) {
+    if constexpr (std::is_arithmetic_v<T> && std::is_arithmetic_v<U>) {
+        if constexpr (std::is_integral_v<T> && std::is_integral_v<U>) {
+            return static_cast<U>(static_cast<T>(x)) == x && ((x < U{}) == (static_cast<T>(x) < T{}));
+        } else if constexpr (std::is_integral_v<T>) {
+            // [lo, hi) holds the integers of T; both bounds are powers of two, exact in U.
+            U hi = 1;
+            for (int i = 0; i < std::numeric_limits<T>::digits; ++i) {
+                hi *= 2;
+            }
+            U lo = std::is_signed_v<T> ? -hi : U{};
+            return x >= lo && x < hi && static_cast<U>(static_cast<T>(x)) == x;
+        } else if constexpr (std::is_integral_v<U>) {
+            auto t = static_cast<T>(x);
+            return exactly_representable<U>(t) && static_cast<U>(t) == x;
+        } else {
+            if constexpr (std::numeric_limits<U>::max_exponent > std::numeric_limits<T>::max_exponent) {
+                // finite values beyond the range of T have no conversion.
+                if (x - x == U{} && (x > std::numeric_limits<T>::max() || x < std::numeric_limits<T>::lowest())) {
+                    return false;
+                }
+            }
+            return static_cast<T>(x) == x;
+        }
+    } else {
+        return true;
+    }
+}
+
+/* returns the last element not greater than key, without data-dependent branches. */
+template<typename T, typename Key>
+constexpr const T* floor_search(const T* base, size_t n, const Key& key) {
+    while (n > 1) {
+        auto half = n / 2;
+        base = !(key < base[half]) ? base + half : base;
+        n -= half;
+    }
+    return base;
+}
+
+/*
+ * fixed_set holds the values of one_of(v1, v2, ...) inline and sorted.
+ * Integral values spanning less than 64 also get a bit mask.
+ */
+template<typename T, size_t N>
+class fixed_set {
+public:
+    template<typename... Args>
+    constexpr explicit fixed_set(const Args&... values) : values_{T(values)...} {
+        for (size_t i = 1; i < N; ++i) {
+            for (size_t j = i; j > 0 && values_[j] < values_[j - 1]; --j) {
+                auto tmp = values_[j];
+                values_[j] = values_[j - 1];
+                values_[j - 1] = tmp;
+            }
+        }
+        if constexpr (std::is_integral_v<T>) {
+            if (static_cast<uint64_t>(values_[N - 1]) - static_cast<uint64_t>(values_[0]) < 64) {
+                for (auto v : values_) {
+                    mask_ |= uint64_t(1) << (static_cast<uint64_t>(v) - static_cast<uint64_t>(values_[0]));
+                }
+            }
+        }
+    }
+
+    constexpr size_t size() const {
+        return N;
+    }
+
+    /* true when membership is a bit test rather than a binary search */
+    constexpr bool masked() const {
+        return mask_ != 0;
+    }
+
+    template<typename U>
+    constexpr bool contains(const U& x) const {
+        if (!exactly_representable<T>(x)) {
+            return false;
+        }
+        if constexpr (std::is_integral_v<T> && std::is_arithmetic_v<U>) {
+            if (mask_ != 0) {
+                auto offset = static_cast<uint64_t>(static_cast<T>(x)) - static_cast<uint64_t>(values_[0]);
+                return offset < 64 && ((mask_ >> offset) & 1) != 0;
+            }
+        }
+        auto key = set_lookup_t<T>(x);
+        return *floor_search(values_.data(), N, key) == key;
+    }
+
+private:
+    std::array<T, N> values_;
+    uint64_t mask_ = 0;
+};
+
+/*
+ * block_bloom_filter is a split-block Bloom filter: each key sets one bit in each
+ * of the eight 32-bit words of one 32-byte block, so a probe touches one cache line.
+ */
+class block_bloom_filter {
+public:
+    block_bloom_filter() = default;
+
+    block_bloom_filter(size_t keys, size_t bits_per_key, size_t max_bytes) {
+        auto wanted = (keys * bits_per_key + block_bits - 1) / block_bits;
+        blocks_ = std::max<size_t>(1, std::min(wanted, max_bytes / sizeof(block)));
+        data_ = std::make_unique<block[]>(blocks_);
+    }
+
+    bool empty() const {
+        return blocks_ == 0;
+    }
+
+    size_t bytes() const {
+        return blocks_ * sizeof(block);
+    }
+
+    void insert(uint64_t hash) {
+        auto& b = data_[block_of(hash)];
+        auto key = static_cast<uint32_t>(hash);
+        for (size_t i = 0; i < 8; ++i) {
+            b.words[i] |= uint32_t(1) << ((key * salts[i]) >> 27);
+        }
+    }
+
+    bool may_contain(uint64_t hash) const {
+        const auto& b = data_[block_of(hash)];
+        auto key = static_cast<uint32_t>(hash);
+#if defined(__AVX2__)
+        auto products = _mm256_mullo_epi32(_mm256_set1_epi32(static_cast<int>(key)),
+            _mm256_setr_epi32(static_cast<int>(salts[0]), static_cast<int>(salts[1]), static_cast<int>(salts[2]),
+                              static_cast<int>(salts[3]), static_cast<int>(salts[4]), static_cast<int>(salts[5]),
+                              static_cast<int>(salts[6]), static_cast<int>(salts[7])));
+        auto mask = _mm256_sllv_epi32(_mm256_set1_epi32(1), _mm256_srli_epi32(products, 27));
+        auto words = _mm256_load_si256(reinterpret_cast<const __m256i*>(b.words));
+        return _mm256_testc_si256(words, mask) != 0;
+#else
+        uint32_t missing = 0;
+        for (size_t i = 0; i < 8; ++i) {
+            missing |= ~b.words[i] & (uint32_t(1) << ((key * salts[i]) >> 27));
+        }
+        return missing == 0;
+#endif
+    }
+
+private:
+    static constexpr size_t block_bits = 256;
+    static constexpr uint32_t salts[8] = {
+        0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+        0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+    };
+
+    struct alignas(32) block {
+        uint32_t words[8];
+    };
+
+    // the high half of the hash picks the block, the low half the bits.
+    size_t block_of(uint64_t hash) const {
+        return static_cast<size_t>(((hash >> 32) * blocks_) >> 32);
+    }
+
+    size_t blocks_ = 0;
+    std::unique_ptr<block[]> data_;
+};
+
+struct set_options {
+    /* puts a Bloom filter in front of hashed sets, for lookups that mostly miss */
+    bool prefilter = false;
+    size_t prefilter_bits_per_key = 16;
+    /* the filter is kept within this size so that it stays in L2 */
+    size_t prefilter_max_bytes = 512 * 1024;
+    /* counts lookups rejected by the filter and false positives */
+    bool collect_stats = false;
+};
+
+struct set_stats {
+    uint64_t lookups = 0;
+    uint64_t rejected = 0;
+    uint64_t false_positives = 0;
+
+    /* the fraction of absent values that the filter failed to reject */
+    double false_positive_rate() const {
+        auto negatives = rejected + false_positives;
+        return negatives == 0 ? 0.0 : static_cast<double>(false_positives) / static_cast<double>(negatives);
+    }
+};
+
+enum class value_set_kind {
+    bitset,
+    sorted,
+    hashed
+};
+
+/*
+ * value_set holds the values of one_of(range) in the representation that suits them:
+ * a bitset for dense integers, a sorted array for small sets and open addressing otherwise.
+ */
+template<typename T>
+class value_set {
+public:
+    using value_type = std::conditional_t<is_string_like_v<T>, std::string, T>;
+    using lookup_type = set_lookup_t<value_type>;
+
+    static constexpr size_t max_sorted_size = 32;
+    static constexpr uint64_t max_bitset_bits = uint64_t(1) << 20;
+
+    template<typename Range>
+    explicit value_set(const Range& values, const set_options& options = {}) {
+        std::vector<value_type> sorted;
+        for (const auto& v : values) {
+            sorted.emplace_back(v);
+        }
+        std::sort(sorted.begin(), sorted.end());
+        sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+        size_ = sorted.size();
+
+        if constexpr (std::is_integral_v<value_type>) {
+            if (!sorted.empty()) {
+                auto span = static_cast<uint64_t>(sorted.back()) - static_cast<uint64_t>(sorted.front()) + 1;
+                // at least one value per 64 bits, so a bitset is no larger than a hash table.
+                if (span != 0 && span <= max_bitset_bits && span <= 64 * sorted.size()) {
+                    build_bitset(sorted, span);
+                    return;
+                }
+            }
+        }
+        if (sorted.size() <= max_sorted_size) {
+            kind_ = value_set_kind::sorted;
+            sorted_ = std::move(sorted);
+        } else {
+            if (options.prefilter) {
+                filter_ = block_bloom_filter(sorted.size(), options.prefilter_bits_per_key, options.prefilter_max_bytes);
+                for (const auto& v : sorted) {
+                    filter_.insert(hash_of(lookup_type(v)));
+                }
+            }
+            build_table(sorted);
+        }
+        if (options.collect_stats) {
+            counters_ = std::make_unique<counters>();
+        }
+    }
+
+    template<typename U>
+    bool contains(const U& x) const {
+        if (!exactly_representable<value_type>(x)) {
+            return false;
+        }
+        if constexpr (std::is_integral_v<value_type>) {
+            if (kind_ == value_set_kind::bitset) {
+                auto offset = static_cast<uint64_t>(static_cast<value_type>(x)) - static_cast<uint64_t>(min_);
+                return offset < span_ && ((bits_[offset / 64] >> (offset % 64)) & 1) != 0;
+            }
+        }
+        auto key = lookup_type(x);
+        if (kind_ == value_set_kind::sorted) {
+            return !sorted_.empty() && *floor_search(sorted_.data(), sorted_.size(), key) == key;
+        }
+        auto hash = hash_of(key);
+        if (!filter_.empty() && !filter_.may_contain(hash)) {
+            count(counters_ ? &counters::rejected : nullptr);
+            return false;
+        }
+        for (auto i = slot_of(hash);; i = (i + 1) & mask_) {
+            if (!occupied_[i]) {
+                count(counters_ && !filter_.empty() ? &counters::false_positives : nullptr);
+                return false;
+            }
+            if (table_[i] == key) {
+                count(nullptr);
+                return true;
+            }
+        }
+    }
+
+    /* lookups of hashed sets; all zero unless set_options::collect_stats was given. */
+    set_stats stats() const {
+        set_stats result;
+        if (counters_) {
+            result.lookups = counters_->lookups.load(std::memory_order_relaxed);
+            result.rejected = counters_->rejected.load(std::memory_order_relaxed);
+            result.false_positives = counters_->false_positives.load(std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+    /* the size of the Bloom filter in bytes, or 0 without one */
+    size_t prefilter_bytes() const {
+        return filter_.empty() ? 0 : filter_.bytes();
+    }
+
+    value_set_kind kind() const {
+        return kind_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    void build_bitset(const std::vector<value_type>& sorted, uint64_t span) {
+        kind_ = value_set_kind::bitset;
+        min_ = sorted.front();
+        span_ = span;
+        bits_.assign((span + 63) / 64, 0);
+        for (auto v : sorted) {
+            auto offset = static_cast<uint64_t>(v) - static_cast<uint64_t>(min_);
+            bits_[offset / 64] |= uint64_t(1) << (offset % 64);
+        }
+    }
+
+    // load factor at most 0.5, so probe sequences stay short and always end at an empty slot.
+    void build_table(std::vector<value_type>& sorted) {
+        kind_ = value_set_kind::hashed;
+        size_t capacity = 4;
+        while (capacity < sorted.size() * 2) {
+            capacity *= 2;
+        }
+        table_.resize(capacity);
+        occupied_.assign(capacity, 0);
+        mask_ = capacity - 1;
+        for (auto& v : sorted) {
+            auto i = slot_of(hash_of(lookup_type(v)));
+            while (occupied_[i]) {
+                i = (i + 1) & mask_;
+            }
+            table_[i] = std::move(v);
+            occupied_[i] = 1;
+        }
+    }
+
+    struct counters {
+        std::atomic<uint64_t> lookups{0};
+        std::atomic<uint64_t> rejected{0};
+        std::atomic<uint64_t> false_positives{0};
+    };
+
+    // relaxed counters are cheap enough to share between matching threads.
+    void count(std::atomic<uint64_t> counters::* outcome) const {
+        if (counters_) {
+            counters_->lookups.fetch_add(1, std::memory_order_relaxed);
+            if (outcome != nullptr) {
+                ((*counters_).*outcome).fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    static uint64_t hash_of(const lookup_type& key) {
+        return static_cast<uint64_t>(std::hash<lookup_type>{}(key)) * 0x9e3779b97f4a7c15ULL;
+    }
+
+    size_t slot_of(uint64_t hash) const {
+        return static_cast<size_t>(hash >> 32) & mask_;
+    }
+
+    value_set_kind kind_ = value_set_kind::sorted;
+    size_t size_ = 0;
+    value_type min_{};
+    uint64_t span_ = 0;
+    std::vector<uint64_t> bits_;
+    std::vector<value_type> sorted_;
+    std::vector<value_type> table_;
+    std::vector<uint8_t> occupied_;
+    size_t mask_ = 0;
+    block_bloom_filter filter_;
+    std::unique_ptr<counters> counters_;
+};
+
+template<typename T, typename = void>
+struct is_range : std::false_type {};
+
+template<typename T>
+struct is_range<T, std::void_t<decltype(std::begin(std::declval<const T&>())),
+                               decltype(std::end(std::declval<const T&>()))>> : std::true_type {};
+
+template<typename T>
+inline constexpr bool is_range_v = is_range<T>::value && !is_string_like_v<T>;
+
+template<typename Set>
+struct set_condition {
+    Set set;
+
+    template<typename X>
+    constexpr bool operator()(const X& x) const {
+        return set.contains(x);
+    }
+};
+
+template<typename T>
+struct shared_set_condition {
+    std::shared_ptr<const value_set<T>> set;
+
+    template<typename X>
+    bool operator()(const X& x) const {
+        return set->contains(x);
+    }
+};
+
+template<typename Condition>
+constexpr auto condition_pattern(const Condition& condition) {
+    return Pattern<Condition, decltype(identity)> {
+        condition,
+        identity
+    };
+}
+
+/* the argument T of a value_set<T>, which may differ from its value_type */
+template<typename Set>
+struct value_set_argument;
+
+template<typename T>
+struct value_set_argument<value_set<T>> { using type = T; };
+
+template<typename T>
+inline constexpr bool is_shared_set_v = false;
+
+template<typename T>
+inline constexpr bool is_shared_set_v<std::shared_ptr<const value_set<T>>> = true;
+
+template<typename T>
+inline constexpr bool is_shared_set_v<std::shared_ptr<value_set<T>>> = true;
+
+template<typename Range>
+auto one_of_range(const Range& values, const set_options& options) {
+    using T = remove_cvref_t<decltype(*std::begin(values))>;
+    return condition_pattern(shared_set_condition<T>{std::make_shared<const value_set<T>>(values, options)});
+}
+
+template<typename... Values>
+constexpr auto one_of_values(const Values&... values) {
+    using T = std::common_type_t<set_value_t<Values>...>;
+    return set_condition<fixed_set<T, sizeof...(Values)>>{fixed_set<T, sizeof...(Values)>(values...)};
+}
+
+/*
+ * one_of(v1, v2, ...) matches any of the listed values with one membership test.
+ * one_of(range[, options]) copies the values of a container into a shared set,
+ * and one_of(shared_ptr<value_set>) shares an existing one, e.g. to read its stats().
+ */
+template<typename First, typename... Rest>
+constexpr auto one_of(const First& first, const Rest&... rest) {
+    if constexpr (sizeof...(Rest) == 0 && is_shared_set_v<First>) {
+        using T = typename value_set_argument<remove_cvref_t<typename First::element_type>>::type;
+        return condition_pattern(shared_set_condition<T>{first});
+    } else if constexpr (sizeof...(Rest) == 0 && is_range_v<First>) {
+        return one_of_range(first, set_options{});
+    } else if constexpr (sizeof...(Rest) == 1 && (std::is_same_v<Rest, set_options> && ...)) {
+        return one_of_range(first, rest...);
+    } else {
+        return condition_pattern(one_of_values(first, rest...));
+    }
+}
+
+/* all_of(p...) / any_of(p...) / not_(p) -> Pattern */
+
+template<typename... Conditions>
+struct all_condition {
+    std::tuple<Conditions...> conditions;
+
+    template<typename X>
+    constexpr bool operator()(const X& x) const {
+        return std::apply([&](const auto&... c) { return (static_cast<bool>(c(x)) && ...); }, conditions);
+    }
+};
+
+template<typename... Conditions>
+struct any_condition {
+    std::tuple<Conditions...> conditions;
+
+    template<typename X>
+    constexpr bool operator()(const X& x) const {
+        return std::apply([&](const auto&... c) { return (static_cast<bool>(c(x)) || ...); }, conditions);
+    }
+};
+
+template<typename Condition>
+struct not_condition {
+    Condition condition;
+
+    template<typename X>
+    constexpr auto operator()(const X& x) const {
+        using Result = decltype(condition(x));
+        if constexpr (is_always_true_v<Result>) {
+            return std::false_type{};
+        } else if constexpr (is_always_false_v<Result>) {
+            return std::true_type{};
+        } else {
+            return !static_cast<bool>(condition(x));
+        }
+    }
+};
+
+template<typename T> inline constexpr bool is_all_condition_v = false;
+template<typename... Cs> inline constexpr bool is_all_condition_v<all_condition<Cs...>> = true;
+template<typename T> inline constexpr bool is_any_condition_v = false;
+template<typename... Cs> inline constexpr bool is_any_condition_v<any_condition<Cs...>> = true;
+template<typename T> inline constexpr bool is_not_condition_v = false;
+template<typename C> inline constexpr bool is_not_condition_v<not_condition<C>> = true;
+
+/* a literal operand of a combinator, compared with == */
+template<typename T>
+inline constexpr bool is_literal_v = !is_pattern_v<T> && !is_wildcard_v<T> && !has_operator_call_v<T>
+                                     && !std::is_function_v<std::remove_pointer_t<std::decay_t<T>>>;
+
+template<typename T>
+constexpr auto condition_of(const T& p) {
+    if constexpr (is_pattern_v<T>) {
+        return p.condition;
+    } else if constexpr (is_wildcard_v<T>) {
+        return pass;
+    } else if constexpr (is_literal_v<T>) {
+        return comparison_condition<std::equal_to<>, set_value_t<T>>{p};
+    } else {
+        return when(p).condition;
+    }
+}
+
+template<typename Op, typename T>
+constexpr auto negate_comparison(const comparison_condition<Op, T>& c) {
+    return comparison_condition<typename negated_comparison<Op>::type, T>{c.value};
+}
+
+/* pushes a negation down to comparisons, which invert their operator once the subject's type is known. */
+template<typename Condition>
+constexpr auto negate(const Condition& c) {
+    if constexpr (is_not_condition_v<Condition>) {
+        return c.condition;
+    } else if constexpr (is_all_condition_v<Condition>) {
+        return std::apply([](const auto&... cs) {
+            return any_condition<decltype(negate(cs))...>{{negate(cs)...}};
+        }, c.conditions);
+    } else if constexpr (is_any_condition_v<Condition>) {
+        return std::apply([](const auto&... cs) {
+            return all_condition<decltype(negate(cs))...>{{negate(cs)...}};
+        }, c.conditions);
+    } else if constexpr (is_comparison_condition_v<Condition>) {
+        return negate_comparison(c);
+    } else {
+        return not_condition<Condition>{c};
+    }
+}
+
+template<typename T>
+struct value_interval {
+    T lo{};
+    T hi{};
+    bool has_lo = false;
+    bool has_hi = false;
+    bool lo_closed = false;
+    bool hi_closed = false;
+};
+
+/*
+ * interval_condition tests a union of ranges of one arithmetic type.
+ * The ranges are sorted and merged, so a value is checked against one range.
+ */
+template<typename T, size_t N>
+class interval_condition {
+public:
+    using interval = value_interval<T>;
+
+    constexpr explicit interval_condition(std::array<interval, N> intervals) {
+        for (size_t i = 1; i < N; ++i) {
+            for (size_t j = i; j > 0 && starts_before(intervals[j], intervals[j - 1]); --j) {
+                auto tmp = intervals[j];
+                intervals[j] = intervals[j - 1];
+                intervals[j - 1] = tmp;
+            }
+        }
+        for (const auto& iv : intervals) {
+            if (size_ > 0 && touches(intervals_[size_ - 1], iv)) {
+                extend(intervals_[size_ - 1], iv);
+            } else {
+                intervals_[size_++] = iv;
+            }
+        }
+    }
+
+    template<typename X>
+    constexpr bool operator()(const X& x) const {
+        const interval* base = intervals_.data();
+        size_t n = size_;
+        while (n > 1) {
+            auto half = n / 2;
+            base = starts_at_or_before(base[half], x) ? base + half : base;
+            n -= half;
+        }
+        return starts_at_or_before(*base, x) && ends_at_or_after(*base, x);
+    }
+
+    /* the number of disjoint ranges after merging */
+    constexpr size_t size() const {
+        return size_;
+    }
+
+private:
+    static constexpr bool starts_before(const interval& a, const interval& b) {
+        if (!a.has_lo || !b.has_lo) {
+            return !a.has_lo && b.has_lo;
+        }
+        return a.lo < b.lo || (a.lo == b.lo && a.lo_closed && !b.lo_closed);
+    }
+
+    // b starts no earlier than a; true if they overlap or meet without a gap.
+    static constexpr bool touches(const interval& a, const interval& b) {
+        if (!a.has_hi || !b.has_lo) {
+            return true;
+        }
+        return b.lo < a.hi || (b.lo == a.hi && (a.hi_closed || b.lo_closed));
+    }
+
+    static constexpr void extend(interval& a, const interval& b) {
+        if (!b.has_hi) {
+            a.has_hi = false;
+        } else if (a.has_hi && (a.hi < b.hi || (a.hi == b.hi && b.hi_closed))) {
+            a.hi = b.hi;
+            a.hi_closed = b.hi_closed;
+        }
+    }
+
+    template<typename X>
+    static constexpr bool starts_at_or_before(const interval& iv, const X& x) {
+        return !iv.has_lo || iv.lo < x || (iv.lo_closed && iv.lo == x);
+    }
+
+    template<typename X>
+    static constexpr bool ends_at_or_after(const interval& iv, const X& x) {
+        return !iv.has_hi || x < iv.hi || (iv.hi_closed && iv.hi == x);
+    }
+
+    std::array<interval, N> intervals_{};
+    size_t size_ = 0;
+};
+
+template<typename T>
+inline constexpr bool is_range_operand_v = false;
+
+template<typename Op>
+inline constexpr bool is_range_comparison_v =
+    std::is_same_v<Op, std::equal_to<>> || std::is_same_v<Op, std::less<>> || std::is_same_v<Op, std::less_equal<>>
+    || std::is_same_v<Op, std::greater<>> || std::is_same_v<Op, std::greater_equal<>>;
+
+template<typename Op, typename T>
+inline constexpr bool is_range_operand_v<comparison_condition<Op, T>> =
+    std::is_arithmetic_v<T> && is_range_comparison_v<typename canonical_comparison<Op>::type>;
+
+template<typename T>
+struct range_operand_value { using type = T; };
+
+template<typename Op, typename T>
+struct range_operand_value<comparison_condition<Op, T>> { using type = T; };
+
+template<typename T, typename Written, typename V>
+constexpr value_interval<T> to_interval(const comparison_condition<Written, V>& c) {
+    using Op = typename canonical_comparison<Written>::type;
+    value_interval<T> iv;
+    auto v = static_cast<T>(c.value);
+    if constexpr (std::is_same_v<Op, std::equal_to<>> || std::is_same_v<Op, std::greater<>>
+                  || std::is_same_v<Op, std::greater_equal<>>) {
+        iv.lo = v;
+        iv.has_lo = true;
+        iv.lo_closed = !std::is_same_v<Op, std::greater<>>;
+    }
+    if constexpr (std::is_same_v<Op, std::equal_to<>> || std::is_same_v<Op, std::less<>>
+                  || std::is_same_v<Op, std::less_equal<>>) {
+        iv.hi = v;
+        iv.has_hi = true;
+        iv.hi_closed = !std::is_same_v<Op, std::less<>>;
+    }
+    return iv;
+}
+
+template<typename T, typename... Ts>
+inline constexpr bool all_same_v = (std::is_same_v<T, Ts> && ...);
+
+// ranges are merged only over one value type; converting the bounds could change what they match.
+template<typename... Conditions>
+constexpr auto any_of_conditions(const Conditions&... cs) {
+    if constexpr ((is_range_operand_v<Conditions> && ...)
+                  && all_same_v<typename range_operand_value<Conditions>::type...>) {
+        using T = std::common_type_t<typename range_operand_value<Conditions>::type...>;
+        return interval_condition<T, sizeof...(Conditions)>({to_interval<T>(cs)...});
+    } else {
+        return any_condition<Conditions...>{{cs...}};
+    }
+}
+
+/* all_of(p...) matches when every operand matches; the handler receives the value itself. */
+template<typename... Patterns>
+constexpr auto all_of(const Patterns&... patterns) {
+    return condition_pattern(all_condition<decltype(condition_of(patterns))...>{{condition_of(patterns)...}});
+}
+
+/*
+ * any_of(p...) matches when some operand matches. Literal operands become a one_of set,
+ * and comparisons of numbers become a sorted union of ranges.
+ */
+template<typename... Patterns>
+constexpr auto any_of(const Patterns&... patterns) {
+    if constexpr ((is_literal_v<Patterns> && ...)) {
+        return condition_pattern(one_of_values(patterns...));
+    } else {
+        return condition_pattern(any_of_conditions(condition_of(patterns)...));
+    }
+}
+
+/* not_(p) matches when p does not; negations of combinators and comparisons are pushed down. */
+template<typename PatternT>
+constexpr auto not_(const PatternT& p) {
+    return condition_pattern(negate(condition_of(p)));
+}
+
+/* match */
+
+struct no_lookup_scope {};
+
+/* unwraps x for the matched arm, then closes the lookup scope before the handler runs. */
+template<typename Scope, typename PatternStatementT, typename Value>
+constexpr decltype(auto) scoped_unwrap(Scope& scope, const PatternStatementT& ps, Value&& x) {
+    if constexpr (std::is_same_v<Scope, no_lookup_scope>) {
+        return ps.unwrap(std::forward<Value>(x));
+    } else {
+        struct close_on_exit {
+            Scope& scope;
+
+            ~close_on_exit() {
+                scope.close();
+            }
+        } close{scope};
+        return ps.unwrap(std::forward<Value>(x));
+    }
+}
+
+template<typename Scope, typename Value, typename PatternStatementT>
+constexpr auto match_arms(Scope& scope, Value&& x, const PatternStatementT& ps) {
+    if (!ps.condition(x)) {
+        throw std::runtime_error("unmatched to all cases");
+    }
+    return ps.handler(scoped_unwrap(scope, ps, std::forward<Value>(x)));
+}
+
+template<typename Scope, typename Value, typename PatternStatementT, typename... RestPatternStatements>
+constexpr auto match_arms(Scope& scope, Value&& x, const PatternStatementT& ps, const RestPatternStatements&... rests) {
+    if constexpr (is_always_false_v<decltype(ps.condition(x))>) {
+        return match_arms(scope, std::forward<Value>(x), rests...);
+    } else {
+        if (ps.condition(x)) {
+            return ps.handler(scoped_unwrap(scope, ps, std::forward<Value>(x)));
+        }
+        return match_arms(scope, std::forward<Value>(x), rests...);
+    }
+}
+
+template<typename Value, typename... PatternStatements>
+constexpr auto match_impl(Value&& x, const PatternStatements&... ps) {
+    if constexpr (is_map_like_v<remove_cvref_t<Value>>) {
+        lookup_scope<remove_cvref_t<Value>> scope(x);
+        return match_arms(scope, std::forward<Value>(x), ps...);
+    } else {
+        no_lookup_scope scope;
+        return match_arms(scope, std::forward<Value>(x), ps...);
+    }
+}
+
+/* matcher_fn keeps the arms of a matcher in a named type, so that its plan can be inspected. */
+template<typename... PatternStatements>
+struct matcher_fn {
+    std::tuple<PatternStatements...> arms;
+
+    template<typename T>
+    constexpr auto operator()(T&& x) const {
+        return std::apply([&](const auto&... ps) { return match_impl(std::forward<T>(x), ps...); }, arms);
+    }
+};
+
+/* prefetch */
+
+inline constexpr size_t cache_line_size = 64;
+
+inline void prefetch(const void* address) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address);
+#else
+    static_cast<void>(address);
+#endif
+}
+
+/*
+ * payload_address(x) returns the separately allocated memory that patterns read
+ * through x, or nullptr. Overload it in the namespace of your type to extend it.
+ */
+template<typename T>
+const void* payload_address(const T&) {
+    return nullptr;
+}
+
+template<typename T>
+const void* payload_address(T* x) {
+    return x;
+}
+
+template<typename T, typename D>
+const void* payload_address(const std::unique_ptr<T, D>& x) {
+    return x.get();
+}
+
+template<typename T>
+const void* payload_address(const std::shared_ptr<T>& x) {
+    return x.get();
+}
+
+inline const void* payload_address(const std::string& x) {
+    return x.data();
+}
+
+template<typename... Ts>
+const void* payload_address(const std::variant<Ts...>& x) {
+    if (x.valueless_by_exception()) {
+        return nullptr;
+    }
+    return std::visit([](const auto& alternative) { return payload_address(alternative); }, x);
+}
+
+/*
+ * reads_payload_v<Condition> is false for conditions known to test a value without reading
+ * the memory it points to: wildcards and comparisons with numbers or nullptr. deref, as<T>,
+ * string comparisons and conditions that cannot be seen into, such as guards, may read it.
+ */
+template<typename T>
+inline constexpr bool is_text_v = is_string_like_v<T> && !std::is_null_pointer_v<T>;
+
+template<typename Condition>
+inline constexpr bool reads_payload_v = true;
+
+template<>
+inline constexpr bool reads_payload_v<remove_cvref_t<decltype(pass)>> = false;
+
+// as<T> hands the held value to its handler; in a std::any it usually lives on the heap.
+template<typename T>
+inline constexpr bool reads_payload_v<as_condition<T>> = true;
+
+template<typename Op, typename T>
+inline constexpr bool reads_payload_v<comparison_condition<Op, T>> = is_text_v<T>;
+
+template<typename T>
+inline constexpr bool reads_payload_v<guard_condition<T>> = !is_literal_v<T> || is_text_v<T>;
+
+template<typename T, size_t N>
+inline constexpr bool reads_payload_v<set_condition<fixed_set<T, N>>> = is_text_v<T>;
+
+template<typename T>
+inline constexpr bool reads_payload_v<shared_set_condition<T>> = is_text_v<T>;
+
+template<typename T, size_t N>
+inline constexpr bool reads_payload_v<interval_condition<T, N>> = false;
+
+template<typename... Conditions>
+inline constexpr bool reads_payload_v<all_condition<Conditions...>> = (reads_payload_v<Conditions> || ...);
+
+template<typename... Conditions>
+inline constexpr bool reads_payload_v<any_condition<Conditions...>> = (reads_payload_v<Conditions> || ...);
+
+template<typename Condition>
+inline constexpr bool reads_payload_v<not_condition<Condition>> = reads_payload_v<Condition>;
+
+/* match_each */
+
+template<typename Condition>
+const void* any_payload_address(const std::any&, const Condition&) {
+    return nullptr;
+}
+
+template<typename T>
+const void* any_payload_address(const std::any& x, const as_condition<T>&) {
+    return std::any_cast<T>(&x);
+}
+
+/* the payload of x; a std::any is looked into with the types of the as<T> arms. */
+template<typename X, typename... PatternStatements>
+const void* element_payload_address(const X& x, const PatternStatements&... ps) {
+    if constexpr (is_any_v<X>) {
+        const void* address = nullptr;
+        static_cast<void>((((address = any_payload_address(x, ps.condition)) != nullptr) || ...));
+        return address;
+    } else {
+        return payload_address(x);
+    }
+}
+
+// the payload of the element `distance` places ahead is requested while the current one is matched,
+// unless no arm reads it.
+template<typename Range, typename... PatternStatements>
+void match_each_impl(Range& range, size_t distance, const PatternStatements&... ps) {
+    if constexpr (!(reads_payload_v<remove_cvref_t<decltype(ps.condition)>> || ...)) {
+        distance = 0;
+    }
+    if (distance == 0) {
+        for (auto&& x : range) {
+            static_cast<void>(match_impl(x, ps...));
+        }
+        return;
+    }
+    auto ahead = std::begin(range);
+    auto last = std::end(range);
+    for (size_t i = 0; i < distance && ahead != last; ++i) {
+        prefetch(element_payload_address(*ahead, ps...));
+        ++ahead;
+    }
+    for (auto&& x : range) {
+        if (ahead != last) {
+            prefetch(element_payload_address(*ahead, ps...));
+            ++ahead;
+        }
+        static_cast<void>(match_impl(x, ps...));
+    }
+}
+
+/* match_grouped */
+
+/* what an arm's condition says about an element known to hold Alternative: true_type, false_type or bool. */
+template<typename Alternative, typename Condition, typename Element>
+struct grouped_verdict {
+    using type = decltype(std::declval<const Condition&>()(std::declval<Element&>()));
+};
+
+template<typename Alternative, typename T, typename Element>
+struct grouped_verdict<Alternative, as_condition<T>, Element> {
+    using type = std::bool_constant<std::is_same_v<T, Alternative>>;
+};
+
+// the scattered order defeats hardware prefetching, so elements are requested ahead.
+template<typename Element, typename Visit>
+void visit_prefetched(Element* const* first, Element* const* last, Visit&& visit) {
+    constexpr std::ptrdiff_t prefetch_distance = 8;
+    for (auto it = first; it != last; ++it) {
+        if (last - it > prefetch_distance) {
+            prefetch(it[prefetch_distance]);
+            prefetch(payload_address(*it[prefetch_distance]));
+        }
+        visit(**it);
+    }
+}
+
+template<typename Alternative, typename Element>
+void match_group(Element* const* first, Element* const* last) {
+    if (first != last) {
+        throw std::runtime_error("unmatched to all cases");
+    }
+}
+
+// Like match_segment: within a group the held alternative is known, so as<T> arms and
+// static conditions are decided once for the group. An arm with a runtime condition
+// falls back to matching each element against it and the arms after it.
+template<typename Alternative, typename Element, typename PatternStatementT, typename... RestPatternStatements>
+void match_group(Element* const* first, Element* const* last,
+                 const PatternStatementT& ps, const RestPatternStatements&... rests) {
+    using Verdict = typename grouped_verdict<Alternative, decltype(ps.condition), Element>::type;
+    if constexpr (is_always_false_v<Verdict>) {
+        match_group<Alternative>(first, last, rests...);
+    } else if constexpr (is_always_true_v<Verdict>) {
+        visit_prefetched(first, last, [&](Element& x) {
+            static_cast<void>(ps.handler(ps.unwrap(x)));
+        });
+    } else {
+        visit_prefetched(first, last, [&](Element& x) {
+            static_cast<void>(match_impl(x, ps, rests...));
+        });
+    }
+}
+
+template<typename Element, size_t... Is, typename... PatternStatements>
+void match_groups(Element* const* order, const size_t* ends, std::index_sequence<Is...>,
+                  const PatternStatements&... ps) {
+    using Variant = remove_cvref_t<Element>;
+    (match_group<std::variant_alternative_t<Is, Variant>>(order + (Is == 0 ? 0 : ends[Is - 1]), order + ends[Is], ps...), ...);
+    // valueless variants hold no alternative; each one is matched on its own.
+    constexpr size_t valueless = sizeof...(Is);
+    visit_prefetched(order + ends[valueless - 1], order + ends[valueless], [&](Element& x) {
+        static_cast<void>(match_impl(x, ps...));
+    });
+}
+
+/* the grouping buffer of the last match_grouped call on this thread, kept for reuse. */
+template<typename Element>
+inline thread_local std::vector<Element*> grouping_buffer;
+
+template<typename Range, typename... PatternStatements>
+void match_grouped_impl(Range& range, const PatternStatements&... ps) {
+    using Element = std::remove_reference_t<decltype(*std::begin(range))>;
+    using Variant = remove_cvref_t<Element>;
+    static_assert(is_variant_v<Variant>, "match_grouped requires a range of std::variant");
+
+    // alternatives are grouped in declaration order; valueless variants form the last group.
+    constexpr size_t alternatives = std::variant_size_v<Variant>;
+    constexpr size_t groups = alternatives + 1;
+    auto group_of = [](const Variant& x) {
+        return x.valueless_by_exception() ? groups - 1 : x.index();
+    };
+
+    // counting pass
+    std::array<size_t, groups + 1> offsets{};
+    for (auto&& x : range) {
+        ++offsets[group_of(x) + 1];
+    }
+    for (size_t i = 1; i <= groups; ++i) {
+        offsets[i] += offsets[i - 1];
+    }
+
+    // stable scatter of element addresses into their groups; afterwards offsets[g] is the end of group g.
+    // The buffer is taken from the thread for the call, so a handler that nests another
+    // match_grouped gets a fresh one rather than the one being visited.
+    std::vector<Element*> order = std::move(grouping_buffer<Element>);
+    order.resize(offsets[groups]);
+    for (auto&& x : range) {
+        order[offsets[group_of(x)]++] = &x;
+    }
+
+    match_groups(order.data(), offsets.data(), std::make_index_sequence<alternatives>{}, ps...);
+
+    order.clear();
+    grouping_buffer<Element> = std::move(order);
+}
+
+}  // namespace easymatch_impl
+
+using easymatch_impl::as;
+using easymatch_impl::some;
+using easymatch_impl::none;
+using easymatch_impl::when;
+using easymatch_impl::_;
+using easymatch_impl::pattern;
+using easymatch_impl::ds;
+using easymatch_impl::split;
+using easymatch_impl::fields;
+using easymatch_impl::parse;
+using easymatch_impl::key;
+using easymatch_impl::has_key;
+using easymatch_impl::deref;
+using easymatch_impl::one_of;
+using easymatch_impl::all_of;
+using easymatch_impl::any_of;
+using easymatch_impl::not_;
+using easymatch_impl::value_set;
+using easymatch_impl::value_set_kind;
+using easymatch_impl::set_options;
+using easymatch_impl::set_stats;
+
+template<typename T>
+constexpr auto match(T&& x) {
+    return [&](auto&&... args) {
+        return easymatch_impl::match_impl(std::forward<decltype(x)>(x), std::forward<decltype(args)>(args)...);
+    };
+}
+
+// the arguments are packed as references with their value categories: ds passes rvalues on to the handlers.
+template<typename... Args>
+constexpr auto match(Args&&... x) {
+    return [&](auto&&... args) {
+        return easymatch_impl::match_impl(std::forward_as_tuple(std::forward<Args>(x)...),
+                                          std::forward<decltype(args)>(args)...);
+    };
+}
+
+/* lookup(map) shares key lookups between arms that reach the map through another subject: match(lookup(map), id)(...). */
+template<typename Map>
+auto lookup(Map& map) {
+    return easymatch_impl::lookup_view<Map>(map);
+}
+
+/* matcher(patterns...) stores the arms once and matches each value passed to it. */
+template<typename... PatternStatements>
+constexpr auto matcher(const PatternStatements&... ps) {
+    return easymatch_impl::matcher_fn<PatternStatements...>{{ps...}};
+}
+
+/*
+ * match_each(range[, prefetch_distance])(patterns...) matches every element in order.
+ * The heap payload of the element prefetch_distance places ahead (string contents,
+ * pointees) is prefetched meanwhile; 0 disables prefetching.
+ */
+template<typename Range>
+auto match_each(Range&& range, size_t prefetch_distance = 16) {
+    return [&range, prefetch_distance](const auto&... args) {
+        easymatch_impl::match_each_impl(range, prefetch_distance, args...);
+    };
+}
+
+/* match_grouped(range)(patterns...) visits elements grouped by their held alternative. */
+template<typename Range>
+auto match_grouped(Range&& range) {
+    return [&](const auto&... args) {
+        easymatch_impl::match_grouped_impl(range, args...);
     };
 }
 
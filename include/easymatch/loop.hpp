@@ -0,0 +1,133 @@
+/*
+ *  Copyright (c) 2023 Yosh31207
+ *  Distributed Under The Apache-2.0 License
+ */
+
+#ifndef EASY_MATCH_LOOP_HPP_
+#define EASY_MATCH_LOOP_HPP_
+
+#include "easymatch/easymatch.hpp"
+
+#include <cstddef>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace easymatch {
+
+/* the handler value that ends a match_loop: pattern | Op::halt = stop_loop */
+struct stop_loop_t {};
+
+inline constexpr auto stop_loop = stop_loop_t{};
+
+namespace easymatch_impl {
+
+inline constexpr size_t max_loop_arms = 32;
+
+/* runs the handler of arm I on x; true when the arm stops the loop. */
+template<size_t I, typename Arms, typename Value>
+bool run_loop_arm(const Arms& arms, Value& x) {
+    const auto& ps = std::get<I>(arms);
+    using Result = decltype(ps.handler(ps.unwrap(x)));
+    if constexpr (std::is_same_v<remove_cvref_t<Result>, stop_loop_t>) {
+        ps.handler(ps.unwrap(x));
+        return true;
+    } else {
+        static_cast<void>(ps.handler(ps.unwrap(x)));
+        return false;
+    }
+}
+
+/* the index of the first arm matching x, or max_loop_arms. */
+template<size_t I = 0, typename Arms, typename Value>
+size_t first_loop_arm(const Arms& arms, const Value& x) {
+    if constexpr (I == std::tuple_size_v<Arms>) {
+        return max_loop_arms;
+    } else {
+        if constexpr (!is_always_false_v<decltype(std::get<I>(arms).condition(x))>) {
+            if (std::get<I>(arms).condition(x)) {
+                return I;
+            }
+        }
+        return first_loop_arm<I + 1>(arms, x);
+    }
+}
+
+[[noreturn]] inline void throw_unmatched() {
+    throw std::runtime_error("unmatched to all cases");
+}
+
+#define EASY_MATCH_LOOP_CASE(H, L) case H * 8 + L: goto arm_##H##_##L;
+#define EASY_MATCH_LOOP_CASES(H)                                                            \
+    EASY_MATCH_LOOP_CASE(H, 0) EASY_MATCH_LOOP_CASE(H, 1) EASY_MATCH_LOOP_CASE(H, 2)        \
+    EASY_MATCH_LOOP_CASE(H, 3) EASY_MATCH_LOOP_CASE(H, 4) EASY_MATCH_LOOP_CASE(H, 5)        \
+    EASY_MATCH_LOOP_CASE(H, 6) EASY_MATCH_LOOP_CASE(H, 7)
+
+/* tries the arms on x and jumps to the first that matches. */
+#define EASY_MATCH_LOOP_DISPATCH                                                            \
+    switch (first_loop_arm(arms, x)) {                                                      \
+        EASY_MATCH_LOOP_CASES(0) EASY_MATCH_LOOP_CASES(1)                                   \
+        EASY_MATCH_LOOP_CASES(2) EASY_MATCH_LOOP_CASES(3)                                   \
+        default: goto unmatched;                                                            \
+    }
+
+#define EASY_MATCH_LOOP_ARM(H, L)                                                           \
+    arm_##H##_##L:                                                                          \
+    if constexpr (H * 8 + L < N) {                                                          \
+        if (run_loop_arm<H * 8 + L>(arms, x)) {                                             \
+            return;                                                                         \
+        }                                                                                   \
+        x = fetch();                                                                        \
+        EASY_MATCH_LOOP_DISPATCH                                                            \
+    }
+#define EASY_MATCH_LOOP_ARMS(H)                                                             \
+    EASY_MATCH_LOOP_ARM(H, 0) EASY_MATCH_LOOP_ARM(H, 1) EASY_MATCH_LOOP_ARM(H, 2)           \
+    EASY_MATCH_LOOP_ARM(H, 3) EASY_MATCH_LOOP_ARM(H, 4) EASY_MATCH_LOOP_ARM(H, 5)           \
+    EASY_MATCH_LOOP_ARM(H, 6) EASY_MATCH_LOOP_ARM(H, 7)
+
+/*
+ * Each arm ends in its own copy of the arm chain, which the compiler threads into
+ * conditional jumps straight to the next arm. The branches of that copy are predicted
+ * from the arm that runs before them, as in threaded code, instead of sharing one
+ * history for all opcodes. Unlike computed goto, this is portable and can be inlined,
+ * so the state the handlers capture stays in registers.
+ */
+template<typename Fetch, typename... PatternStatements>
+void match_loop_impl(Fetch& fetch, const PatternStatements&... ps) {
+    constexpr size_t N = sizeof...(PatternStatements);
+    static_assert(N <= max_loop_arms, "match_loop supports at most 32 arms");
+
+    auto arms = std::forward_as_tuple(ps...);
+    auto x = fetch();
+    EASY_MATCH_LOOP_DISPATCH
+
+    EASY_MATCH_LOOP_ARMS(0) EASY_MATCH_LOOP_ARMS(1) EASY_MATCH_LOOP_ARMS(2) EASY_MATCH_LOOP_ARMS(3)
+
+unmatched:
+    throw_unmatched();
+}
+
+#undef EASY_MATCH_LOOP_ARMS
+#undef EASY_MATCH_LOOP_ARM
+#undef EASY_MATCH_LOOP_DISPATCH
+#undef EASY_MATCH_LOOP_CASES
+#undef EASY_MATCH_LOOP_CASE
+
+}  // namespace easymatch_impl
+
+/*
+ * match_loop(fetch)(patterns...) repeats "x = fetch(); match(x)(patterns...)" until an arm
+ * whose handler is, or returns, stop_loop. Each arm dispatches the next value itself,
+ * so an interpreter loop does not return to one dispatch branch shared by all opcodes.
+ */
+template<typename Fetch>
+auto match_loop(Fetch&& fetch) {
+    return [&fetch](const auto&... ps) {
+        easymatch_impl::match_loop_impl(fetch, ps...);
+    };
+}
+
+}  // namespace easymatch
+
+#endif  // EASY_MATCH_LOOP_HPP_
@@ -0,0 +1,178 @@
+/*
+ *  Copyright (c) 2023 Yosh31207
+ *  Distributed Under The Apache-2.0 License
+ */
+
+#ifndef EASY_MATCH_MAILBOX_HPP_
+#define EASY_MATCH_MAILBOX_HPP_
+
+#include "easymatch/easymatch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace easymatch {
+
+namespace easymatch_impl {
+
+inline size_t round_up_to_power_of_two(size_t n) {
+    size_t result = 1;
+    while (result < n) {
+        result *= 2;
+    }
+    return result;
+}
+
+}  // namespace easymatch_impl
+
+struct mailbox_stats {
+    uint64_t messages = 0;
+    uint64_t batches = 0;
+    uint64_t dispatch_ns = 0;
+    uint64_t max_batch_ns = 0;
+
+    /* mean dispatch time of a message in nanoseconds */
+    double mean_dispatch_ns() const {
+        return messages == 0 ? 0.0 : static_cast<double>(dispatch_ns) / static_cast<double>(messages);
+    }
+};
+
+/*
+ * mailbox<Message> is a bounded lock-free queue for many producers and one consumer.
+ * The consumer drains messages in batches: it does no read-modify-write per message
+ * and publishes the freed slots with one store per batch.
+ */
+template<typename Message>
+class mailbox {
+public:
+    explicit mailbox(size_t capacity)
+        : capacity_(easymatch_impl::round_up_to_power_of_two(std::max<size_t>(capacity, 2))),
+          slots_(std::make_unique<slot[]>(capacity_)) {
+        for (size_t i = 0; i < capacity_; ++i) {
+            slots_[i].sequence.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    mailbox(const mailbox&) = delete;
+    mailbox& operator=(const mailbox&) = delete;
+
+    ~mailbox() {
+        auto head = head_.load(std::memory_order_relaxed);
+        auto tail = tail_.load(std::memory_order_relaxed);
+        for (auto pos = head; pos != tail; ++pos) {
+            auto& s = slots_[pos & (capacity_ - 1)];
+            if (s.sequence.load(std::memory_order_acquire) == pos + 1) {
+                s.message()->~Message();
+            }
+        }
+    }
+
+    size_t capacity() const {
+        return capacity_;
+    }
+
+    /* returns false without blocking if the mailbox is full. Safe from any thread. */
+    template<typename T>
+    bool try_push(T&& message) {
+        auto pos = tail_.load(std::memory_order_relaxed);
+        do {
+            if (pos - head_.load(std::memory_order_acquire) >= capacity_) {
+                return false;
+            }
+        } while (!tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed));
+
+        auto& s = slots_[pos & (capacity_ - 1)];
+        new (&s.storage) Message(std::forward<T>(message));
+        s.sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* waits while the mailbox is full. Safe from any thread. */
+    template<typename T>
+    void push(T&& message) {
+        while (!try_push(std::forward<T>(message))) {
+            std::this_thread::yield();
+        }
+    }
+
+    /*
+     * dispatches up to max_batch ready messages to handler and returns their number.
+     * Consumer thread only; handler is usually a matcher(...).
+     */
+    template<typename Handler>
+    size_t drain(const Handler& handler, size_t max_batch = 256) {
+        constexpr size_t prefetch_distance = 4;
+
+        auto begin = std::chrono::steady_clock::now();
+        auto head = head_.load(std::memory_order_relaxed);
+        size_t n = 0;
+        try {
+            for (; n < max_batch; ++n) {
+                auto& s = slots_[(head + n) & (capacity_ - 1)];
+                if (s.sequence.load(std::memory_order_acquire) != head + n + 1) {
+                    break;
+                }
+                easymatch_impl::prefetch(&slots_[(head + n + prefetch_distance) & (capacity_ - 1)]);
+                auto message = s.message();
+                release_on_exit release{message};
+                handler(std::move(*message));
+            }
+        } catch (...) {
+            head_.store(head + n + 1, std::memory_order_release);
+            throw;
+        }
+        if (n == 0) {
+            return 0;
+        }
+        head_.store(head + n, std::memory_order_release);
+
+        auto elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - begin).count());
+        stats_.messages += n;
+        stats_.batches += 1;
+        stats_.dispatch_ns += elapsed;
+        stats_.max_batch_ns = std::max(stats_.max_batch_ns, elapsed);
+        return n;
+    }
+
+    /* consumer thread only, or after the consumer has stopped. */
+    const mailbox_stats& stats() const {
+        return stats_;
+    }
+
+private:
+    struct slot {
+        std::atomic<size_t> sequence;
+        std::aligned_storage_t<sizeof(Message), alignof(Message)> storage;
+
+        Message* message() {
+            return std::launder(reinterpret_cast<Message*>(&storage));
+        }
+    };
+
+    struct release_on_exit {
+        Message* message;
+
+        ~release_on_exit() {
+            message->~Message();
+        }
+    };
+
+    const size_t capacity_;
+    std::unique_ptr<slot[]> slots_;
+    alignas(easymatch_impl::cache_line_size) std::atomic<size_t> head_{0};
+    alignas(easymatch_impl::cache_line_size) std::atomic<size_t> tail_{0};
+    alignas(easymatch_impl::cache_line_size) mailbox_stats stats_;
+};
+
+}  // namespace easymatch
+
+#endif  // EASY_MATCH_MAILBOX_HPP_
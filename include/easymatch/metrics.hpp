@@ -0,0 +1,382 @@
+/*
+ *  Copyright (c) 2023 Yosh31207
+ *  Distributed Under The Apache-2.0 License
+ */
+
+#ifndef EASY_MATCH_METRICS_HPP_
+#define EASY_MATCH_METRICS_HPP_
+
+#include "easymatch/easymatch.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+/* branch hints and out-of-line placement; they expand to nothing where the compiler lacks them. */
+#if defined(__GNUC__) || defined(__clang__)
+#define EASY_MATCH_LIKELY(x) __builtin_expect(!!(x), 1)
+#define EASY_MATCH_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#define EASY_MATCH_COLD [[gnu::noinline, gnu::cold]]
+#else
+#define EASY_MATCH_LIKELY(x) (x)
+#define EASY_MATCH_UNLIKELY(x) (x)
+#define EASY_MATCH_COLD
+#endif
+
+namespace easymatch {
+namespace easymatch_impl {
+
+/* the index of the highest set bit of a nonzero value, by repeated halving. */
+constexpr unsigned highest_bit_portable(uint64_t value) {
+    unsigned bit = 0;
+    for (unsigned shift = 32; shift != 0; shift /= 2) {
+        if (value >> shift) {
+            value >>= shift;
+            bit += shift;
+        }
+    }
+    return bit;
+}
+
+/* the index of the highest set bit of a nonzero value. */
+inline unsigned highest_bit(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - static_cast<unsigned>(__builtin_clzll(value));
+#else
+    return highest_bit_portable(value);
+#endif
+}
+
+}  // namespace easymatch_impl
+
+/*
+ * latency_histogram counts values in log-linear buckets: each power of two is split
+ * into 32 linear buckets, so any recorded value is known within about 3%.
+ * Its memory is fixed; recording never allocates. Histograms of the same site
+ * recorded on different threads are combined with merge().
+ */
+class latency_histogram {
+public:
+    static constexpr unsigned sub_bucket_bits = 5;
+    static constexpr uint64_t sub_buckets = uint64_t(1) << sub_bucket_bits;
+    static constexpr size_t bucket_count = (64 - sub_bucket_bits + 1) * sub_buckets;
+
+    void record(uint64_t value) {
+        ++counts_[index_of(value)];
+        ++total_;
+        sum_ += value;
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+
+    uint64_t count() const {
+        return total_;
+    }
+
+    uint64_t min() const {
+        return total_ == 0 ? 0 : min_;
+    }
+
+    uint64_t max() const {
+        return max_;
+    }
+
+    double mean() const {
+        return total_ == 0 ? 0.0 : static_cast<double>(sum_) / static_cast<double>(total_);
+    }
+
+    /* the smallest value that at least `percent` percent of the records do not exceed, within bucket precision. */
+    uint64_t percentile(double percent) const {
+        if (total_ == 0) {
+            return 0;
+        }
+        auto rank = static_cast<uint64_t>(std::clamp(percent, 0.0, 100.0) / 100.0 * static_cast<double>(total_) + 0.5);
+        rank = std::clamp<uint64_t>(rank, 1, total_);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < bucket_count; ++i) {
+            seen += counts_[i];
+            if (seen >= rank) {
+                return std::clamp(highest_of(i), min_, max_);
+            }
+        }
+        return max_;
+    }
+
+    void merge(const latency_histogram& other) {
+        for (size_t i = 0; i < bucket_count; ++i) {
+            counts_[i] += other.counts_[i];
+        }
+        total_ += other.total_;
+        sum_ += other.sum_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+
+    void reset() {
+        *this = latency_histogram();
+    }
+
+private:
+    static size_t index_of(uint64_t value) {
+        if (value < sub_buckets) {
+            return static_cast<size_t>(value);
+        }
+        unsigned msb = easymatch_impl::highest_bit(value);
+        unsigned shift = msb - sub_bucket_bits;
+        return static_cast<size_t>((shift + 1) * sub_buckets + (value >> shift) - sub_buckets);
+    }
+
+    static uint64_t highest_of(size_t index) {
+        if (index < sub_buckets) {
+            return index;
+        }
+        auto shift = index / sub_buckets - 1;
+        auto mantissa = index % sub_buckets + sub_buckets;
+        auto next = (mantissa + 1) << shift;
+        return next == 0 ? std::numeric_limits<uint64_t>::max() : next - 1;
+    }
+
+    std::array<uint64_t, bucket_count> counts_{};
+    uint64_t total_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t min_ = std::numeric_limits<uint64_t>::max();
+    uint64_t max_ = 0;
+};
+
+/* guard and handler times of one arm in nanoseconds; handler.count() is the number of hits. */
+struct arm_latency {
+    latency_histogram guard;
+    latency_histogram handler;
+
+    void merge(const arm_latency& other) {
+        guard.merge(other.guard);
+        handler.merge(other.handler);
+    }
+};
+
+/* per-arm latency of a match site with N arms; copy it to take a snapshot. */
+template<size_t N>
+struct match_metrics {
+    std::array<arm_latency, N> arms;
+
+    void merge(const match_metrics& other) {
+        for (size_t i = 0; i < N; ++i) {
+            arms[i].merge(other.arms[i]);
+        }
+    }
+
+    void reset() {
+        for (auto& arm : arms) {
+            arm = arm_latency();
+        }
+    }
+};
+
+namespace easymatch_impl {
+
+inline uint64_t now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// the end of one guard is the start of the next, so a call reads the clock once per evaluated guard and once more.
+template<size_t I, size_t N, typename Value, typename PatternStatementT, typename... RestPatternStatements>
+auto timed_match_impl(match_metrics<N>& metrics, uint64_t begin, Value&& x, const PatternStatementT& ps,
+                      const RestPatternStatements&... rests) {
+    if constexpr (is_always_false_v<decltype(ps.condition(x))> && sizeof...(RestPatternStatements) > 0) {
+        return timed_match_impl<I + 1>(metrics, begin, std::forward<Value>(x), rests...);
+    } else {
+        auto& arm = metrics.arms[I];
+        bool matched = ps.condition(x);
+        auto guarded = now_ns();
+        arm.guard.record(guarded - begin);
+
+        if (!matched) {
+            if constexpr (sizeof...(RestPatternStatements) == 0) {
+                throw std::runtime_error("unmatched to all cases");
+            } else {
+                return timed_match_impl<I + 1>(metrics, guarded, std::forward<Value>(x), rests...);
+            }
+        }
+        using Result = decltype(ps.handler(ps.unwrap(std::forward<Value>(x))));
+        if constexpr (std::is_void_v<Result>) {
+            ps.handler(ps.unwrap(std::forward<Value>(x)));
+            arm.handler.record(now_ns() - guarded);
+        } else {
+            auto result = ps.handler(ps.unwrap(std::forward<Value>(x)));
+            arm.handler.record(now_ns() - guarded);
+            return result;
+        }
+    }
+}
+
+}  // namespace easymatch_impl
+
+/*
+ * sampled_metrics<N> instruments about one in `period` calls of a match site; the others
+ * take the plain match path after one decrement. The gap between samples is drawn
+ * uniformly from [1, 2 * period - 1] so periodic workloads do not alias with it.
+ * A sampled call reads the clock twice and counts the guards it evaluates; per-guard
+ * times are left to timed_match, as clock reads dominate the cost of a sample.
+ * It is not synchronised: keep one per thread (thread_local) and merge snapshots.
+ */
+template<size_t N>
+class sampled_metrics {
+public:
+    explicit sampled_metrics(uint32_t period, uint64_t seed = 0x9e3779b97f4a7c15)
+        : period_(std::max<uint32_t>(period, 1)), state_(seed == 0 ? 1 : seed) {
+        countdown_ = next_gap();
+    }
+
+    /* true when the current call is to be instrumented. */
+    bool sample() {
+        if (EASY_MATCH_LIKELY(--countdown_ != 0)) {
+            return false;
+        }
+        countdown_ = next_gap();
+        ++samples_;
+        return true;
+    }
+
+    uint32_t period() const {
+        return period_;
+    }
+
+    /* the number of instrumented calls. */
+    uint64_t samples() const {
+        return samples_;
+    }
+
+    /* how often the guard of arm i was evaluated in instrumented calls. */
+    uint64_t evaluations(size_t i) const {
+        return evaluations_[i];
+    }
+
+    /* how often arm i was chosen in instrumented calls. */
+    uint64_t hits(size_t i) const {
+        return latency_[i].count();
+    }
+
+    /* time of the instrumented calls that chose arm i, from the first guard to the end of the handler. */
+    const latency_histogram& latency(size_t i) const {
+        return latency_[i];
+    }
+
+    /* time of all instrumented calls that matched. */
+    latency_histogram total() const {
+        latency_histogram h;
+        for (const auto& arm : latency_) {
+            h.merge(arm);
+        }
+        return h;
+    }
+
+    void merge(const sampled_metrics& other) {
+        samples_ += other.samples_;
+        for (size_t i = 0; i < N; ++i) {
+            evaluations_[i] += other.evaluations_[i];
+            latency_[i].merge(other.latency_[i]);
+        }
+    }
+
+    /* matches x against the arms and records the call; kept out of line so that the unsampled path stays small. */
+    template<typename Value, typename... PatternStatements>
+    EASY_MATCH_COLD auto instrumented(Value&& x, const PatternStatements&... ps) {
+        return instrumented_impl<0>(easymatch_impl::now_ns(), std::forward<Value>(x), ps...);
+    }
+
+private:
+    uint32_t next_gap() {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 7;
+        state_ ^= state_ << 17;
+        return 1 + static_cast<uint32_t>(state_ % (2 * uint64_t(period_) - 1));
+    }
+
+    template<size_t I, typename Value, typename PatternStatementT, typename... RestPatternStatements>
+    auto instrumented_impl(uint64_t start, Value&& x, const PatternStatementT& ps,
+                           const RestPatternStatements&... rests) {
+        if constexpr (easymatch_impl::is_always_false_v<decltype(ps.condition(x))> &&
+                      sizeof...(RestPatternStatements) > 0) {
+            return instrumented_impl<I + 1>(start, std::forward<Value>(x), rests...);
+        } else {
+            ++evaluations_[I];
+            if (!ps.condition(x)) {
+                if constexpr (sizeof...(RestPatternStatements) == 0) {
+                    throw std::runtime_error("unmatched to all cases");
+                } else {
+                    return instrumented_impl<I + 1>(start, std::forward<Value>(x), rests...);
+                }
+            }
+            using Result = decltype(ps.handler(ps.unwrap(std::forward<Value>(x))));
+            if constexpr (std::is_void_v<Result>) {
+                ps.handler(ps.unwrap(std::forward<Value>(x)));
+                latency_[I].record(easymatch_impl::now_ns() - start);
+            } else {
+                auto result = ps.handler(ps.unwrap(std::forward<Value>(x)));
+                latency_[I].record(easymatch_impl::now_ns() - start);
+                return result;
+            }
+        }
+    }
+
+    uint32_t period_;
+    uint32_t countdown_ = 1;
+    uint64_t state_;
+    uint64_t samples_ = 0;
+    std::array<uint64_t, N> evaluations_{};
+    std::array<latency_histogram, N> latency_;
+};
+
+/*
+ * timed_match(metrics, x)(patterns...) matches like match(x)(patterns...) and records
+ * the time of every evaluated guard and of the chosen handler into metrics.
+ */
+template<size_t N, typename T>
+auto timed_match(match_metrics<N>& metrics, T&& x) {
+    return [&metrics, &x](const auto&... args) {
+        static_assert(sizeof...(args) <= N, "match_metrics has fewer entries than arms");
+        return easymatch_impl::timed_match_impl<0>(metrics, easymatch_impl::now_ns(), std::forward<T>(x), args...);
+    };
+}
+
+/*
+ * sampled_match(site, x)(patterns...) matches like match(x)(patterns...) and
+ * records the call into site when it is sampled.
+ */
+template<size_t N, typename T>
+auto sampled_match(sampled_metrics<N>& site, T&& x) {
+    return [&site, &x](const auto&... args) {
+        static_assert(sizeof...(args) <= N, "sampled_metrics has fewer entries than arms");
+        if (EASY_MATCH_UNLIKELY(site.sample())) {
+            return site.instrumented(std::forward<T>(x), args...);
+        }
+        return easymatch_impl::match_impl(std::forward<T>(x), args...);
+    };
+}
+
+/*
+ * sampled_matcher(site, patterns...) stores the arms once like matcher(patterns...);
+ * unlike sampled_match, the unsampled path does not have to materialise the arms
+ * for the out-of-line instrumented call, so it costs only the countdown.
+ */
+template<size_t N, typename... PatternStatements>
+auto sampled_matcher(sampled_metrics<N>& site, const PatternStatements&... ps) {
+    static_assert(sizeof...(ps) <= N, "sampled_metrics has fewer entries than arms");
+    return [&site, ps...](auto&& x) {
+        if (EASY_MATCH_UNLIKELY(site.sample())) {
+            return site.instrumented(std::forward<decltype(x)>(x), ps...);
+        }
+        return easymatch_impl::match_impl(std::forward<decltype(x)>(x), ps...);
+    };
+}
+
+}  // namespace easymatch
+
+#endif  // EASY_MATCH_METRICS_HPP_
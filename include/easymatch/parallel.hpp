@@ -0,0 +1,604 @@
+/*
+ *  Copyright (c) 2023 Yosh31207
+ *  Distributed Under The Apache-2.0 License
+ */
+
+#ifndef EASY_MATCH_PARALLEL_HPP_
+#define EASY_MATCH_PARALLEL_HPP_
+
+#include "easymatch/easymatch.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace easymatch {
+
+namespace easymatch_impl {
+
+/* task */
+
+class pool_task {
+public:
+    virtual ~pool_task() = default;
+
+    void execute() {
+        try {
+            run();
+        } catch (...) {
+            error_ = std::current_exception();
+        }
+        done_.store(true, std::memory_order_release);
+    }
+
+    bool done() const {
+        return done_.load(std::memory_order_acquire);
+    }
+
+    void rethrow_if_failed() const {
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+    }
+
+private:
+    virtual void run() = 0;
+
+    std::atomic<bool> done_{false};
+    std::exception_ptr error_;
+};
+
+/* per-thread task queue; the owner works on the back and thieves take the front */
+
+class task_deque {
+public:
+    void push(pool_task* task) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(task);
+    }
+
+    pool_task* pop() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (tasks_.empty()) {
+            return nullptr;
+        }
+        auto task = tasks_.back();
+        tasks_.pop_back();
+        return task;
+    }
+
+    pool_task* steal() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (tasks_.empty()) {
+            return nullptr;
+        }
+        auto task = tasks_.front();
+        tasks_.pop_front();
+        return task;
+    }
+
+private:
+    std::mutex mutex_;
+    std::deque<pool_task*> tasks_;
+};
+
+}  // namespace easymatch_impl
+
+/*
+ * work_stealing_pool runs forked tasks on a fixed set of worker threads.
+ * Threads that wait for a forked task keep running queued tasks meanwhile,
+ * so nested forks never block a worker.
+ */
+class work_stealing_pool {
+public:
+    explicit work_stealing_pool(size_t threads = std::thread::hardware_concurrency())
+        : queues_(std::max<size_t>(threads, 1) + 1) {
+        auto workers = queues_.size() - 1;
+        threads_.reserve(workers);
+        for (size_t i = 0; i < workers; ++i) {
+            threads_.emplace_back([this, i] { worker_loop(i); });
+        }
+    }
+
+    work_stealing_pool(const work_stealing_pool&) = delete;
+    work_stealing_pool& operator=(const work_stealing_pool&) = delete;
+
+    ~work_stealing_pool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wakeup_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    size_t size() const {
+        return threads_.size();
+    }
+
+    /* queues the task on the calling thread's deque. */
+    void submit(easymatch_impl::pool_task* task) {
+        queues_[current_queue()].push(task);
+        queued_.fetch_add(1);
+        if (sleeping_.load() > 0) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            wakeup_.notify_one();
+        }
+    }
+
+    /* runs queued tasks until the task is done. */
+    void wait(const easymatch_impl::pool_task& task) {
+        auto self = current_queue();
+        while (!task.done()) {
+            if (!run_one(self)) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+private:
+    // Callers outside the pool share the last queue.
+    size_t current_queue() const {
+        return current_pool() == this ? current_index() : queues_.size() - 1;
+    }
+
+    static const work_stealing_pool*& current_pool() {
+        thread_local const work_stealing_pool* pool = nullptr;
+        return pool;
+    }
+
+    static size_t& current_index() {
+        thread_local size_t index = 0;
+        return index;
+    }
+
+    bool run_one(size_t self) {
+        auto task = queues_[self].pop();
+        for (size_t i = 1; task == nullptr && i < queues_.size(); ++i) {
+            task = queues_[(self + i) % queues_.size()].steal();
+        }
+        if (task == nullptr) {
+            return false;
+        }
+        queued_.fetch_sub(1);
+        task->execute();
+        return true;
+    }
+
+    void worker_loop(size_t index) {
+        current_pool() = this;
+        current_index() = index;
+
+        constexpr int spins_before_sleep = 64;
+        int idle = 0;
+        while (true) {
+            if (run_one(index)) {
+                idle = 0;
+                continue;
+            }
+            if (++idle < spins_before_sleep) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mutex_);
+            sleeping_.fetch_add(1);
+            wakeup_.wait(lock, [this] { return stop_ || queued_.load() > 0; });
+            sleeping_.fetch_sub(1);
+            if (stop_) {
+                return;
+            }
+            idle = 0;
+        }
+    }
+
+    std::vector<easymatch_impl::task_deque> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> queued_{0};
+    std::atomic<size_t> sleeping_{0};
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    bool stop_ = false;
+};
+
+namespace easymatch_impl {
+
+/* fold */
+
+inline size_t default_spawn_depth(const work_stealing_pool& pool) {
+    // enough tasks near the root to keep every worker busy after stealing.
+    size_t depth = 3;
+    for (size_t n = 1; n < pool.size(); n *= 2) {
+        ++depth;
+    }
+    return depth;
+}
+
+template<typename R, typename Node, typename Step>
+class fold_context {
+public:
+    fold_context(work_stealing_pool& pool, const Step& step, size_t spawn_depth, size_t depth)
+        : pool_(pool), step_(step), spawn_depth_(spawn_depth), depth_(depth) {}
+
+    /* evaluates a child on the current thread. */
+    R operator()(const Node& child) const {
+        auto context = fold_context(pool_, step_, spawn_depth_, depth_ + 1);
+        return step_(context, child);
+    }
+
+    /* evaluates children as parallel tasks near the root, and serially below the spawn depth. */
+    template<typename... Children>
+    std::array<R, sizeof...(Children)> fork(const Children&... children) const {
+        std::array<const Node*, sizeof...(Children)> nodes = {&children...};
+        std::array<R, sizeof...(Children)> results{};
+        if (depth_ >= spawn_depth_ || sizeof...(Children) < 2) {
+            for (size_t i = 0; i < nodes.size(); ++i) {
+                results[i] = (*this)(*nodes[i]);
+            }
+            return results;
+        }
+
+        // the first child runs here, the others are offered to the pool.
+        std::array<std::optional<fold_task>, sizeof...(Children)> tasks;
+        for (size_t i = 1; i < nodes.size(); ++i) {
+            tasks[i].emplace(*this, *nodes[i], results[i]);
+            pool_.submit(&*tasks[i]);
+        }
+
+        // submitted tasks refer to this frame, so they are joined even on failure.
+        std::exception_ptr error;
+        try {
+            results[0] = (*this)(*nodes[0]);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        for (size_t i = nodes.size() - 1; i > 0; --i) {
+            pool_.wait(*tasks[i]);
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        for (size_t i = 1; i < nodes.size(); ++i) {
+            tasks[i]->rethrow_if_failed();
+        }
+        return results;
+    }
+
+    size_t depth() const {
+        return depth_;
+    }
+
+private:
+    class fold_task : public pool_task {
+    public:
+        fold_task(const fold_context& parent, const Node& node, R& result)
+            : parent_(parent), node_(node), result_(result) {}
+
+    private:
+        void run() override {
+            result_ = parent_(node_);
+        }
+
+        const fold_context& parent_;
+        const Node& node_;
+        R& result_;
+    };
+
+    work_stealing_pool& pool_;
+    const Step& step_;
+    size_t spawn_depth_;
+    size_t depth_;
+};
+
+}  // namespace easymatch_impl
+
+/*
+ * parallel_fold evaluates a recursive tree with step(self, node).
+ * The step usually returns match(node)(...); its arms evaluate children with
+ * self(child) serially or self.fork(children...) in parallel.
+ */
+template<typename R, typename Node, typename Step>
+R parallel_fold(work_stealing_pool& pool, const Node& root, const Step& step, size_t spawn_depth) {
+    auto context = easymatch_impl::fold_context<R, Node, Step>(pool, step, spawn_depth, 0);
+    return step(context, root);
+}
+
+template<typename R, typename Node, typename Step>
+R parallel_fold(work_stealing_pool& pool, const Node& root, const Step& step) {
+    return parallel_fold<R>(pool, root, step, easymatch_impl::default_spawn_depth(pool));
+}
+
+/* batch executor */
+
+struct batch_options {
+    /* worker i is pinned to cores[i]; without cores, `threads` unpinned workers are started */
+    std::vector<int> cores;
+    size_t threads = std::thread::hardware_concurrency();
+    /* chunk sizes adapt so that one chunk takes about target_chunk_ns */
+    size_t min_chunk = 16;
+    size_t max_chunk = 1 << 16;
+    uint64_t target_chunk_ns = 100000;
+};
+
+/* each worker updates only its own entry; a cache line apiece keeps neighbours from false sharing. */
+struct alignas(easymatch_impl::cache_line_size) worker_stats {
+    int core = -1;              // the pinned core, or -1
+    uint64_t elements = 0;
+    uint64_t chunks = 0;
+    uint64_t busy_ns = 0;       // time spent matching
+    uint64_t wall_ns = 0;       // time from the start of the run until the worker ran out of work
+
+    double utilisation() const {
+        return wall_ns == 0 ? 0.0 : static_cast<double>(busy_ns) / static_cast<double>(wall_ns);
+    }
+};
+
+/*
+ * batch_result holds the results of batch_executor::map in the arenas of the workers
+ * that produced them. Each arena lists the input ranges it covers.
+ */
+template<typename R>
+class batch_result {
+public:
+    struct segment {
+        size_t first;       // index of the first input element
+        size_t offset;      // position of its result in the arena
+        size_t count;
+    };
+
+    struct alignas(easymatch_impl::cache_line_size) arena {
+        std::vector<R> values;
+        std::vector<segment> segments;
+    };
+
+    explicit batch_result(size_t workers, size_t size) : arenas_(workers), size_(size) {}
+
+    size_t size() const {
+        return size_;
+    }
+
+    const std::vector<arena>& arenas() const {
+        return arenas_;
+    }
+
+    /* calls fn(index, result) for every element, in no particular order. */
+    template<typename Fn>
+    void for_each(Fn&& fn) const {
+        for (const auto& a : arenas_) {
+            for (const auto& seg : a.segments) {
+                for (size_t i = 0; i < seg.count; ++i) {
+                    fn(seg.first + i, a.values[seg.offset + i]);
+                }
+            }
+        }
+    }
+
+    /* collects the results in input order. */
+    std::vector<R> to_vector() const {
+        std::vector<R> result(size_);
+        for_each([&](size_t i, const R& value) { result[i] = value; });
+        return result;
+    }
+
+    arena& arena_of(size_t worker) {
+        return arenas_[worker];
+    }
+
+private:
+    std::vector<arena> arenas_;
+    size_t size_;
+};
+
+/*
+ * batch_executor applies one matcher to every element of a batch on a fixed set
+ * of worker threads, optionally pinned to cores. Workers claim chunks from a shared
+ * cursor, size them from their own measured cost per element, and write results into
+ * arenas they allocate themselves. The calling thread only waits.
+ */
+class batch_executor {
+public:
+    explicit batch_executor(batch_options options = {})
+        : options_(std::move(options)) {
+        auto workers = options_.cores.empty() ? std::max<size_t>(options_.threads, 1) : options_.cores.size();
+        options_.min_chunk = std::max<size_t>(options_.min_chunk, 1);
+        options_.max_chunk = std::max(options_.max_chunk, options_.min_chunk);
+        stats_.resize(workers);
+        threads_.reserve(workers);
+        for (size_t i = 0; i < workers; ++i) {
+            threads_.emplace_back([this, i] { worker_loop(i); });
+        }
+    }
+
+    batch_executor(const batch_executor&) = delete;
+    batch_executor& operator=(const batch_executor&) = delete;
+
+    ~batch_executor() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        start_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    size_t size() const {
+        return threads_.size();
+    }
+
+    /* returns fn(x) for every x of a random-access input; fn is usually a matcher(...). */
+    template<typename Range, typename Fn>
+    auto map(const Range& input, const Fn& fn) {
+        using R = easymatch_impl::remove_cvref_t<decltype(fn(*std::begin(input)))>;
+        auto first = std::begin(input);
+        auto count = static_cast<size_t>(std::distance(first, std::end(input)));
+        batch_result<R> result(threads_.size(), count);
+
+        run(count, [&](size_t worker, size_t begin, size_t end) {
+            auto& arena = result.arena_of(worker);
+            arena.segments.push_back({begin, arena.values.size(), end - begin});
+            for (auto i = begin; i < end; ++i) {
+                arena.values.push_back(fn(first[i]));
+            }
+        });
+        return result;
+    }
+
+    /* calls fn(x) for every x of input and discards the results. */
+    template<typename Range, typename Fn>
+    void for_each(const Range& input, const Fn& fn) {
+        auto first = std::begin(input);
+        auto count = static_cast<size_t>(std::distance(first, std::end(input)));
+        run(count, [&](size_t, size_t begin, size_t end) {
+            for (auto i = begin; i < end; ++i) {
+                static_cast<void>(fn(first[i]));
+            }
+        });
+    }
+
+    /* per-worker statistics of the last run */
+    const std::vector<worker_stats>& stats() const {
+        return stats_;
+    }
+
+private:
+    using chunk_fn = std::function<void(size_t worker, size_t begin, size_t end)>;
+
+    static uint64_t now_ns() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // a core outside the range cpu_set_t can hold leaves the worker unpinned.
+    static bool pin_to_core(int core) {
+#if defined(__linux__)
+        if (core < 0 || core >= CPU_SETSIZE) {
+            return false;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(core, &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+        static_cast<void>(core);
+        return false;
+#endif
+    }
+
+    // runs one batch at a time: concurrent callers wait for the batch before theirs.
+    // fn must not start a batch on the same executor, which would wait for itself.
+    void run(size_t size, chunk_fn chunk) {
+        std::lock_guard<std::mutex> batch(batch_mutex_);
+        std::unique_lock<std::mutex> lock(mutex_);
+        chunk_ = std::move(chunk);
+        size_ = size;
+        cursor_.store(0, std::memory_order_relaxed);
+        error_ = nullptr;
+        running_ = threads_.size();
+        start_ns_ = now_ns();
+        ++generation_;
+        start_.notify_all();
+        done_.wait(lock, [this] { return running_ == 0; });
+        chunk_ = nullptr;
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+    }
+
+    void worker_loop(size_t index) {
+        if (!options_.cores.empty() && pin_to_core(options_.cores[index])) {
+            stats_[index].core = options_.cores[index];
+        }
+        uint64_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                start_.wait(lock, [&] { return stop_ || generation_ != seen; });
+                if (stop_) {
+                    return;
+                }
+                seen = generation_;
+            }
+            work(index);
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--running_ == 0) {
+                done_.notify_one();
+            }
+        }
+    }
+
+    // each worker sizes its next chunk from the cost per element of its previous one.
+    void work(size_t index) {
+        auto& s = stats_[index];
+        s = worker_stats{s.core};
+        size_t chunk = options_.min_chunk;
+        try {
+            while (true) {
+                auto begin = cursor_.fetch_add(chunk, std::memory_order_relaxed);
+                if (begin >= size_) {
+                    break;
+                }
+                auto end = std::min(size_, begin + chunk);
+                auto t0 = now_ns();
+                chunk_(index, begin, end);
+                auto elapsed = std::max<uint64_t>(now_ns() - t0, 1);
+
+                s.elements += end - begin;
+                s.chunks += 1;
+                s.busy_ns += elapsed;
+                auto per_element = static_cast<double>(elapsed) / static_cast<double>(end - begin);
+                auto next = static_cast<double>(options_.target_chunk_ns) / per_element;
+                chunk = std::clamp(static_cast<size_t>(next), options_.min_chunk, options_.max_chunk);
+            }
+        } catch (...) {
+            cursor_.store(size_, std::memory_order_relaxed);
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_) {
+                error_ = std::current_exception();
+            }
+        }
+        s.wall_ns = now_ns() - start_ns_;
+    }
+
+    batch_options options_;
+    std::vector<std::thread> threads_;
+    std::vector<worker_stats> stats_;
+
+    std::mutex batch_mutex_;
+    std::mutex mutex_;
+    std::condition_variable start_;
+    std::condition_variable done_;
+    uint64_t generation_ = 0;
+    size_t running_ = 0;
+    bool stop_ = false;
+
+    chunk_fn chunk_;
+    size_t size_ = 0;
+    uint64_t start_ns_ = 0;
+    std::exception_ptr error_;
+    alignas(easymatch_impl::cache_line_size) std::atomic<size_t> cursor_{0};
+};
+
+}  // namespace easymatch
+
+#endif  // EASY_MATCH_PARALLEL_HPP_
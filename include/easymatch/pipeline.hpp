@@ -0,0 +1,389 @@
+/*
+ *  Copyright (c) 2023 Yosh31207
+ *  Distributed Under The Apache-2.0 License
+ */
+
+#ifndef EASY_MATCH_PIPELINE_HPP_
+#define EASY_MATCH_PIPELINE_HPP_
+
+#include "easymatch/easymatch.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace easymatch {
+
+/*
+ * spsc_ring is a bounded queue for one producer and one consumer.
+ * Each side keeps a private copy of the other side's index and rereads it only
+ * when the copy says the ring is full or empty, and both sides publish a batch with one store.
+ */
+template<typename T>
+class spsc_ring {
+public:
+    using value_type = T;
+
+    explicit spsc_ring(size_t capacity) {
+        capacity_ = 2;
+        while (capacity_ < capacity) {
+            capacity_ *= 2;
+        }
+        slots_ = std::make_unique<slot[]>(capacity_);
+    }
+
+    spsc_ring(const spsc_ring&) = delete;
+    spsc_ring& operator=(const spsc_ring&) = delete;
+
+    ~spsc_ring() {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        for (auto pos = head_.load(std::memory_order_relaxed); pos != tail; ++pos) {
+            item(pos)->~T();
+        }
+    }
+
+    size_t capacity() const {
+        return capacity_;
+    }
+
+    /* moves items from [first, last) until the ring is full; returns their number. Producer only. */
+    template<typename It>
+    size_t push_batch(It first, It last) {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        auto wanted = static_cast<size_t>(std::distance(first, last));
+        if (capacity_ - (tail - cached_head_) < wanted) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+        }
+        auto n = std::min(wanted, capacity_ - (tail - cached_head_));
+        for (size_t i = 0; i < n; ++i, ++first) {
+            new (&slots_[(tail + i) & (capacity_ - 1)]) T(std::move(*first));
+        }
+        if (n > 0) {
+            tail_.store(tail + n, std::memory_order_release);
+        }
+        return n;
+    }
+
+    /* Producer only. */
+    bool try_push(T&& x) {
+        return push_batch(&x, &x + 1) == 1;
+    }
+
+    /*
+     * passes up to max ready items to fn(T&&) and frees their slots at once. Consumer only.
+     * If fn throws, the items before it and the item it threw on are consumed; the rest stay.
+     */
+    template<typename Fn>
+    size_t consume(size_t max, Fn&& fn) {
+        auto head = head_.load(std::memory_order_relaxed);
+        if (cached_tail_ - head < max) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+        }
+        auto n = std::min(max, cached_tail_ - head);
+        size_t i = 0;
+        try {
+            for (; i < n; ++i) {
+                destroy_on_exit destroy{item(head + i)};
+                fn(std::move(*destroy.x));
+            }
+        } catch (...) {
+            head_.store(head + i + 1, std::memory_order_release);
+            throw;
+        }
+        if (n > 0) {
+            head_.store(head + n, std::memory_order_release);
+        }
+        return n;
+    }
+
+    /* no more items will be pushed. Producer only. */
+    void close() {
+        closed_.store(true, std::memory_order_release);
+    }
+
+    /* true once the ring is closed and every item has been consumed. Consumer only. */
+    bool finished() const {
+        return closed_.load(std::memory_order_acquire)
+            && tail_.load(std::memory_order_acquire) == head_.load(std::memory_order_relaxed);
+    }
+
+private:
+    using slot = std::aligned_storage_t<sizeof(T), alignof(T)>;
+
+    T* item(size_t pos) {
+        return std::launder(reinterpret_cast<T*>(&slots_[pos & (capacity_ - 1)]));
+    }
+
+    struct destroy_on_exit {
+        T* x;
+
+        ~destroy_on_exit() {
+            x->~T();
+        }
+    };
+
+    size_t capacity_;
+    std::unique_ptr<slot[]> slots_;
+    alignas(easymatch_impl::cache_line_size) std::atomic<size_t> head_{0};
+    size_t cached_tail_ = 0;
+    alignas(easymatch_impl::cache_line_size) std::atomic<size_t> tail_{0};
+    size_t cached_head_ = 0;
+    alignas(easymatch_impl::cache_line_size) std::atomic<bool> closed_{false};
+};
+
+struct stage_stats {
+    uint64_t items = 0;
+    uint64_t batches = 0;
+    uint64_t busy_ns = 0;       // time spent in the stage function
+    uint64_t max_batch_ns = 0;
+    uint64_t stalled_ns = 0;    // time waiting for room downstream (backpressure)
+
+    /* mean processing time of an item in nanoseconds */
+    double mean_item_ns() const {
+        return items == 0 ? 0.0 : static_cast<double>(busy_ns) / static_cast<double>(items);
+    }
+};
+
+namespace easymatch_impl {
+
+/* the ring feeding each stage; stage i turns items of ring i into items of ring i + 1 */
+
+template<typename Ring, typename Tuple>
+struct prepend_ring;
+
+template<typename Ring, typename... Rings>
+struct prepend_ring<Ring, std::tuple<Rings...>> {
+    using type = std::tuple<Ring, Rings...>;
+};
+
+template<typename In, typename... Fns>
+struct stage_rings {
+    using type = std::tuple<>;
+};
+
+template<typename In, typename Fn, typename... Rest>
+struct stage_rings<In, Fn, Rest...> {
+    using out_type = remove_cvref_t<std::invoke_result_t<const Fn&, In&&>>;
+    using type = typename prepend_ring<std::unique_ptr<spsc_ring<In>>,
+                                       typename stage_rings<out_type, Rest...>::type>::type;
+};
+
+class stage_counters {
+public:
+    void add_batch(uint64_t items, uint64_t ns) {
+        items_.fetch_add(items, std::memory_order_relaxed);
+        batches_.fetch_add(1, std::memory_order_relaxed);
+        busy_ns_.fetch_add(ns, std::memory_order_relaxed);
+        if (ns > max_batch_ns_.load(std::memory_order_relaxed)) {
+            max_batch_ns_.store(ns, std::memory_order_relaxed);
+        }
+    }
+
+    void add_stall(uint64_t ns) {
+        stalled_ns_.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    stage_stats snapshot() const {
+        stage_stats s;
+        s.items = items_.load(std::memory_order_relaxed);
+        s.batches = batches_.load(std::memory_order_relaxed);
+        s.busy_ns = busy_ns_.load(std::memory_order_relaxed);
+        s.max_batch_ns = max_batch_ns_.load(std::memory_order_relaxed);
+        s.stalled_ns = stalled_ns_.load(std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    // written only by the stage thread; relaxed atomics let stats() read them while running.
+    alignas(cache_line_size) std::atomic<uint64_t> items_{0};
+    std::atomic<uint64_t> batches_{0};
+    std::atomic<uint64_t> busy_ns_{0};
+    std::atomic<uint64_t> max_batch_ns_{0};
+    std::atomic<uint64_t> stalled_ns_{0};
+};
+
+inline uint64_t elapsed_ns(std::chrono::steady_clock::time_point since) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - since).count());
+}
+
+}  // namespace easymatch_impl
+
+/*
+ * pipeline runs each stage function on its own thread. Stages are connected by
+ * spsc_rings and move items in batches; the last stage is the sink and returns nothing.
+ * A full ring makes the upstream stage, and finally push(), wait.
+ */
+template<typename In, typename... Fns>
+class pipeline {
+public:
+    static constexpr size_t stages = sizeof...(Fns);
+
+    pipeline(size_t capacity, size_t batch, Fns... fns)
+        : fns_(std::move(fns)...), batch_(std::max<size_t>(batch, 1)) {
+        std::apply([&](auto&... rings) {
+            ((rings = std::make_unique<typename std::remove_reference_t<decltype(rings)>::element_type>(capacity)), ...);
+        }, rings_);
+        start(std::index_sequence_for<Fns...>{});
+    }
+
+    pipeline(const pipeline&) = delete;
+    pipeline& operator=(const pipeline&) = delete;
+
+    ~pipeline() {
+        try {
+            close();
+        } catch (...) {
+        }
+    }
+
+    /* returns false, leaving x untouched, if the first ring is full. */
+    bool try_push(In&& x) {
+        return std::get<0>(rings_)->try_push(std::move(x));
+    }
+
+    /* waits while the first ring is full; throws if a stage has failed. */
+    void push(In x) {
+        while (!std::get<0>(rings_)->try_push(std::move(x))) {
+            if (failed_.load(std::memory_order_acquire)) {
+                throw std::runtime_error("pipeline stage failed");
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    /* ends the input, waits until every item has reached the sink and rethrows a stage failure. */
+    void close() {
+        if (closed_) {
+            return;
+        }
+        closed_ = true;
+        std::get<0>(rings_)->close();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+        for (auto& error : errors_) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+    /* counters of every stage; may be read while the pipeline runs. */
+    std::array<stage_stats, stages> stats() const {
+        std::array<stage_stats, stages> result;
+        for (size_t i = 0; i < stages; ++i) {
+            result[i] = counters_[i].snapshot();
+        }
+        return result;
+    }
+
+private:
+    template<size_t... Is>
+    void start(std::index_sequence<Is...>) {
+        (threads_.emplace_back([this] { run_stage<Is>(); }), ...);
+    }
+
+    template<size_t I>
+    void run_stage() {
+        auto& in = *std::get<I>(rings_);
+        try {
+            stage_loop<I>(in);
+        } catch (...) {
+            errors_[I] = std::current_exception();
+            failed_.store(true, std::memory_order_release);
+            // keep consuming so that upstream stages can finish.
+            while (!in.finished()) {
+                if (in.consume(batch_, [](auto&&) {}) == 0) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+        if constexpr (I + 1 < stages) {
+            std::get<I + 1>(rings_)->close();
+        }
+    }
+
+    template<size_t I, typename Ring>
+    void stage_loop(Ring& in) {
+        const auto& fn = std::get<I>(fns_);
+        auto& counters = counters_[I];
+        if constexpr (I + 1 < stages) {
+            auto& out = *std::get<I + 1>(rings_);
+            using Out = typename std::remove_reference_t<decltype(out)>::value_type;
+            std::vector<Out> produced;
+            produced.reserve(batch_);
+            while (!in.finished()) {
+                auto begin = std::chrono::steady_clock::now();
+                auto n = in.consume(batch_, [&](auto&& x) { produced.push_back(fn(std::move(x))); });
+                if (n == 0) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                counters.add_batch(n, easymatch_impl::elapsed_ns(begin));
+                forward(out, produced, counters);
+            }
+        } else {
+            while (!in.finished()) {
+                auto begin = std::chrono::steady_clock::now();
+                auto n = in.consume(batch_, [&](auto&& x) { fn(std::move(x)); });
+                if (n == 0) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                counters.add_batch(n, easymatch_impl::elapsed_ns(begin));
+            }
+        }
+    }
+
+    template<typename Ring, typename Out>
+    void forward(Ring& out, std::vector<Out>& produced, easymatch_impl::stage_counters& counters) {
+        auto first = produced.begin();
+        first += static_cast<std::ptrdiff_t>(out.push_batch(first, produced.end()));
+        if (first != produced.end()) {
+            auto begin = std::chrono::steady_clock::now();
+            while (first != produced.end()) {
+                std::this_thread::yield();
+                first += static_cast<std::ptrdiff_t>(out.push_batch(first, produced.end()));
+            }
+            counters.add_stall(easymatch_impl::elapsed_ns(begin));
+        }
+        produced.clear();
+    }
+
+    std::tuple<Fns...> fns_;
+    typename easymatch_impl::stage_rings<In, Fns...>::type rings_;
+    size_t batch_;
+    std::array<easymatch_impl::stage_counters, stages> counters_;
+    std::array<std::exception_ptr, stages> errors_;
+    std::atomic<bool> failed_{false};
+    std::vector<std::thread> threads_;
+    bool closed_ = false;
+};
+
+/*
+ * make_pipeline<In>(capacity, batch, stages..., sink) starts a pipeline.
+ * Every stage but the sink returns the item for the next one; a stage is usually a matcher(...).
+ */
+template<typename In, typename... Fns>
+auto make_pipeline(size_t capacity, size_t batch, Fns... fns) {
+    static_assert(sizeof...(Fns) > 0, "a pipeline needs at least a sink");
+    return std::make_unique<pipeline<In, Fns...>>(capacity, batch, std::move(fns)...);
+}
+
+}  // namespace easymatch
+
+#endif  // EASY_MATCH_PIPELINE_HPP_
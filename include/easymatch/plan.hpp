@@ -0,0 +1,282 @@
+/*
+ *  Copyright (c) 2023 Yosh31207
+ *  Distributed Under The Apache-2.0 License
+ */
+
+#ifndef EASY_MATCH_PLAN_HPP_
+#define EASY_MATCH_PLAN_HPP_
+
+#include "easymatch/easymatch.hpp"
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace easymatch {
+
+/*
+ * How one arm of a matcher tests a value. The arms themselves are tried in order;
+ * the strategy is what a single arm lowers to.
+ */
+enum class arm_strategy {
+    always,     // wildcard, never fails
+    compare,    // one comparison with a constant: _ < 10, or a literal: pattern | 10
+    fixed_set,  // one_of(v1, v2, ...): bit mask or binary search over inline values
+    value_set,  // one_of(range): bitset, sorted array or hash table chosen at run time
+    interval,   // any_of over comparisons: binary search over merged ranges
+    all_of,
+    any_of,
+    not_,
+    guard       // any other pattern, evaluated as written
+};
+
+struct arm_plan {
+    arm_strategy strategy;
+    size_t table_size;  // entries of the strategy's table; 0 if it has none or its size is known only at run time
+    size_t operands;    // operands of all_of, any_of and not_
+};
+
+constexpr const char* to_string(arm_strategy strategy) {
+    switch (strategy) {
+        case arm_strategy::always:    return "always";
+        case arm_strategy::compare:   return "compare";
+        case arm_strategy::fixed_set: return "fixed_set";
+        case arm_strategy::value_set: return "value_set";
+        case arm_strategy::interval:  return "interval";
+        case arm_strategy::all_of:    return "all_of";
+        case arm_strategy::any_of:    return "any_of";
+        case arm_strategy::not_:      return "not_";
+        case arm_strategy::guard:     return "guard";
+    }
+    return "unknown";
+}
+
+/* never defined: instantiating it prints the strategies of a plan in the compiler's error message */
+template<arm_strategy... Strategies>
+struct plan_diagnostic;
+
+namespace easymatch_impl {
+
+template<typename Condition>
+struct arm_plan_of {
+    static constexpr arm_plan value{
+        std::is_same_v<Condition, remove_cvref_t<decltype(pass)>> ? arm_strategy::always : arm_strategy::guard, 0, 0};
+};
+
+template<typename Op, typename T>
+struct arm_plan_of<comparison_condition<Op, T>> {
+    static constexpr arm_plan value{arm_strategy::compare, 0, 0};
+};
+
+/* when(v) with a value rather than a function compares with ==. */
+template<typename T>
+inline constexpr bool is_literal_guard_v = !has_operator_call_v<T> && !std::is_function_v<std::remove_pointer_t<T>>;
+
+template<typename T>
+struct arm_plan_of<guard_condition<T>> {
+    static constexpr arm_plan value{is_literal_guard_v<T> ? arm_strategy::compare : arm_strategy::guard, 0, 0};
+};
+
+template<typename T, size_t N>
+struct arm_plan_of<set_condition<fixed_set<T, N>>> {
+    static constexpr arm_plan value{arm_strategy::fixed_set, N, 0};
+};
+
+template<typename T>
+struct arm_plan_of<shared_set_condition<T>> {
+    static constexpr arm_plan value{arm_strategy::value_set, 0, 0};
+};
+
+template<typename T, size_t N>
+struct arm_plan_of<interval_condition<T, N>> {
+    static constexpr arm_plan value{arm_strategy::interval, N, 0};
+};
+
+template<typename... Conditions>
+struct arm_plan_of<all_condition<Conditions...>> {
+    static constexpr arm_plan value{arm_strategy::all_of, 0, sizeof...(Conditions)};
+};
+
+template<typename... Conditions>
+struct arm_plan_of<any_condition<Conditions...>> {
+    static constexpr arm_plan value{arm_strategy::any_of, 0, sizeof...(Conditions)};
+};
+
+template<typename Condition>
+struct arm_plan_of<not_condition<Condition>> {
+    static constexpr arm_plan value{arm_strategy::not_, 0, 1};
+};
+
+template<typename T>
+struct matcher_plan;
+
+template<typename... PatternStatements>
+struct matcher_plan<matcher_fn<PatternStatements...>> {
+    static constexpr std::array<arm_plan, sizeof...(PatternStatements)> value{
+        arm_plan_of<remove_cvref_t<decltype(PatternStatements::condition)>>::value...
+    };
+};
+
+template<typename Op> inline constexpr const char* comparison_name = "?";
+template<> inline constexpr const char* comparison_name<std::equal_to<>> = "==";
+template<> inline constexpr const char* comparison_name<std::not_equal_to<>> = "!=";
+template<> inline constexpr const char* comparison_name<std::less<>> = "<";
+template<> inline constexpr const char* comparison_name<std::less_equal<>> = "<=";
+template<> inline constexpr const char* comparison_name<std::greater<>> = ">";
+template<> inline constexpr const char* comparison_name<std::greater_equal<>> = ">=";
+template<> inline constexpr const char* comparison_name<negated<std::equal_to<>>> = "not ==";
+template<> inline constexpr const char* comparison_name<negated<std::not_equal_to<>>> = "not !=";
+template<> inline constexpr const char* comparison_name<negated<std::less<>>> = "not <";
+template<> inline constexpr const char* comparison_name<negated<std::less_equal<>>> = "not <=";
+template<> inline constexpr const char* comparison_name<negated<std::greater<>>> = "not >";
+template<> inline constexpr const char* comparison_name<negated<std::greater_equal<>>> = "not >=";
+
+template<typename T>
+inline constexpr bool is_fixed_set_condition_v = false;
+
+template<typename T, size_t N>
+inline constexpr bool is_fixed_set_condition_v<set_condition<fixed_set<T, N>>> = true;
+
+template<typename T>
+inline constexpr bool is_shared_set_condition_v = false;
+
+template<typename T>
+inline constexpr bool is_shared_set_condition_v<shared_set_condition<T>> = true;
+
+template<typename T>
+inline constexpr bool is_interval_condition_v = false;
+
+template<typename T, size_t N>
+inline constexpr bool is_interval_condition_v<interval_condition<T, N>> = true;
+
+template<typename T>
+std::string describe_value_set(const value_set<T>& set) {
+    std::string text = "value_set ";
+    switch (set.kind()) {
+        case value_set_kind::bitset: text += "bitset"; break;
+        case value_set_kind::sorted: text += "sorted"; break;
+        case value_set_kind::hashed: text += "hashed"; break;
+    }
+    text += ", " + std::to_string(set.size()) + " values";
+    if (auto bytes = set.prefilter_bytes(); bytes != 0) {
+        text += ", " + std::to_string(bytes) + " byte prefilter";
+    }
+    return text;
+}
+
+template<typename Op> inline constexpr const char* comparison_name<reversed<Op>> =
+    comparison_name<typename canonical_comparison<reversed<Op>>::type>;
+template<typename Op> inline constexpr const char* comparison_name<negated<reversed<Op>>> =
+    comparison_name<negated<typename canonical_comparison<reversed<Op>>::type>>;
+
+template<typename Op, typename T>
+std::string describe_comparison(const comparison_condition<Op, T>&) {
+    return std::string("compare ") + comparison_name<Op>;
+}
+
+template<typename Condition>
+std::string describe_condition(const Condition& c);
+
+template<typename Tuple>
+std::string describe_operands(const char* name, const Tuple& conditions) {
+    std::string text = name;
+    text += "(";
+    std::apply([&](const auto&... cs) {
+        const char* separator = "";
+        ((text += separator, text += describe_condition(cs), separator = ", "), ...);
+    }, conditions);
+    return text + ")";
+}
+
+template<typename Condition>
+std::string describe_condition(const Condition& c) {
+    if constexpr (is_comparison_condition_v<Condition>) {
+        return describe_comparison(c);
+    } else if constexpr (is_fixed_set_condition_v<Condition>) {
+        return "fixed_set " + std::string(c.set.masked() ? "bit mask" : "binary search") + ", "
+            + std::to_string(c.set.size()) + " values";
+    } else if constexpr (is_shared_set_condition_v<Condition>) {
+        return describe_value_set(*c.set);
+    } else if constexpr (arm_plan_of<Condition>::value.strategy == arm_strategy::compare) {
+        return "compare ==";
+    } else if constexpr (is_interval_condition_v<Condition>) {
+        return "interval binary search, " + std::to_string(c.size()) + " ranges";
+    } else if constexpr (is_all_condition_v<Condition>) {
+        return describe_operands("all_of", c.conditions);
+    } else if constexpr (is_any_condition_v<Condition>) {
+        return describe_operands("any_of", c.conditions);
+    } else if constexpr (is_not_condition_v<Condition>) {
+        return "not_(" + describe_condition(c.condition) + ")";
+    } else {
+        return to_string(arm_plan_of<Condition>::value.strategy);
+    }
+}
+
+template<typename Matcher, typename = std::make_index_sequence<matcher_plan<remove_cvref_t<Matcher>>::value.size()>>
+struct plan_strategies;
+
+template<typename Matcher, size_t... Is>
+struct plan_strategies<Matcher, std::index_sequence<Is...>> {
+    using diagnostic = plan_diagnostic<matcher_plan<remove_cvref_t<Matcher>>::value[Is].strategy...>;
+
+    template<arm_strategy... Expected>
+    static constexpr bool equals() {
+        constexpr auto& plan = matcher_plan<remove_cvref_t<Matcher>>::value;
+        if constexpr (sizeof...(Expected) != sizeof...(Is)) {
+            return false;
+        } else {
+            return ((plan[Is].strategy == Expected) && ...);
+        }
+    }
+};
+
+}  // namespace easymatch_impl
+
+/* plan_v<decltype(m)> is the plan of matcher m, one entry per arm, known at compile time. */
+template<typename Matcher>
+inline constexpr auto plan_v = easymatch_impl::matcher_plan<easymatch_impl::remove_cvref_t<Matcher>>::value;
+
+template<typename... PatternStatements>
+constexpr auto plan_of(const easymatch_impl::matcher_fn<PatternStatements...>&) {
+    return plan_v<easymatch_impl::matcher_fn<PatternStatements...>>;
+}
+
+/*
+ * expect_plan<decltype(m), strategies...>() is true when m's arms use the given strategies,
+ * and fails to compile otherwise, naming the actual ones, so that CI can pin a plan:
+ *   static_assert(expect_plan<decltype(m), arm_strategy::fixed_set, arm_strategy::always>());
+ */
+template<typename Matcher, arm_strategy... Expected>
+constexpr bool expect_plan() {
+    using strategies = easymatch_impl::plan_strategies<Matcher>;
+    if constexpr (!strategies::template equals<Expected...>()) {
+        return sizeof(typename strategies::diagnostic) == 0;
+    } else {
+        return true;
+    }
+}
+
+/*
+ * describe(m) lists the arms of matcher m and the strategy of each, including the
+ * representations of run-time sets, e.g.
+ *   0: fixed_set bit mask, 3 values
+ *   1: value_set hashed, 1000 values, 2048 byte prefilter
+ *   2: always
+ */
+template<typename... PatternStatements>
+std::string describe(const easymatch_impl::matcher_fn<PatternStatements...>& m) {
+    std::string text = std::to_string(sizeof...(PatternStatements)) + " arms, tried in order\n";
+    size_t index = 0;
+    std::apply([&](const auto&... ps) {
+        ((text += "  " + std::to_string(index++) + ": " + easymatch_impl::describe_condition(ps.condition) + "\n"), ...);
+    }, m.arms);
+    return text;
+}
+
+}  // namespace easymatch
+
+#endif  // EASY_MATCH_PLAN_HPP_
@@ -0,0 +1,145 @@
+/*
+ *  Copyright (c) 2023 Yosh31207
+ *  Distributed Under The Apache-2.0 License
+ */
+
+#ifndef EASY_MATCH_POLY_VECTOR_HPP_
+#define EASY_MATCH_POLY_VECTOR_HPP_
+
+#include "easymatch/easymatch.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace easymatch {
+
+namespace easymatch_impl {
+
+/* utility */
+
+template<typename T, typename... Ts>
+struct index_of;
+
+template<typename T, typename... Ts>
+struct index_of<T, T, Ts...> : std::integral_constant<size_t, 0> {};
+
+template<typename T, typename U, typename... Ts>
+struct index_of<T, U, Ts...> : std::integral_constant<size_t, 1 + index_of<T, Ts...>::value> {};
+
+template<typename T, typename... Ts>
+inline constexpr size_t index_of_v = index_of<T, Ts...>::value;
+
+/* match_segment */
+
+template<typename Segment>
+void match_segment(Segment& segment) {
+    if (!segment.empty()) {
+        throw std::runtime_error("unmatched to all cases");
+    }
+}
+
+// Arms whose condition is statically false for the element type are skipped and
+// a statically true arm takes the whole segment, so no per-element dispatch is left.
+// Arms with runtime conditions fall back to matching each element.
+template<typename Segment, typename PatternStatementT, typename... RestPatternStatements>
+void match_segment(Segment& segment, const PatternStatementT& ps, const RestPatternStatements&... rests) {
+    using Condition = decltype(ps.condition(segment.front()));
+    if constexpr (is_always_false_v<Condition>) {
+        match_segment(segment, rests...);
+    } else if constexpr (is_always_true_v<Condition>) {
+        for (auto& x : segment) {
+            static_cast<void>(ps.handler(ps.unwrap(x)));
+        }
+    } else {
+        for (auto& x : segment) {
+            static_cast<void>(match_impl(x, ps, rests...));
+        }
+    }
+}
+
+}  // namespace easymatch_impl
+
+/*
+ * poly_vector<Ts...> stores each alternative in its own contiguous array.
+ * The alternative of every insertion is also logged (one byte per element),
+ * so the elements can be visited in insertion order when needed.
+ */
+template<typename... Ts>
+class poly_vector {
+    static_assert(sizeof...(Ts) <= 256, "poly_vector supports up to 256 alternatives");
+
+public:
+    template<typename T, typename U = easymatch_impl::remove_cvref_t<T>>
+    void push_back(T&& x) {
+        segment<U>().push_back(std::forward<T>(x));
+        order_.push_back(static_cast<std::uint8_t>(easymatch_impl::index_of_v<U, Ts...>));
+    }
+
+    template<typename T, typename... Args>
+    T& emplace_back(Args&&... args) {
+        auto& element = segment<T>().emplace_back(std::forward<Args>(args)...);
+        order_.push_back(static_cast<std::uint8_t>(easymatch_impl::index_of_v<T, Ts...>));
+        return element;
+    }
+
+    template<typename T>
+    std::vector<T>& segment() {
+        return std::get<std::vector<T>>(segments_);
+    }
+
+    template<typename T>
+    const std::vector<T>& segment() const {
+        return std::get<std::vector<T>>(segments_);
+    }
+
+    size_t size() const {
+        return order_.size();
+    }
+
+    bool empty() const {
+        return order_.empty();
+    }
+
+    void clear() {
+        std::apply([](auto&... segments) { (segments.clear(), ...); }, segments_);
+        order_.clear();
+    }
+
+    /* visits segment by segment; the arm is chosen once per segment when possible. */
+    template<typename... PatternStatements>
+    void match_all(const PatternStatements&... ps) {
+        std::apply([&](auto&... segments) {
+            (easymatch_impl::match_segment(segments, ps...), ...);
+        }, segments_);
+    }
+
+    /* visits elements in insertion order, dispatching each one. */
+    template<typename... PatternStatements>
+    void match_ordered(const PatternStatements&... ps) {
+        match_ordered_impl(std::index_sequence_for<Ts...>{}, ps...);
+    }
+
+private:
+    template<size_t... Is, typename... PatternStatements>
+    void match_ordered_impl(std::index_sequence<Is...>, const PatternStatements&... ps) {
+        std::array<size_t, sizeof...(Ts)> cursors{};
+        for (auto index : order_) {
+            static_cast<void>(((index == Is
+                ? (static_cast<void>(easymatch_impl::match_impl(std::get<Is>(segments_)[cursors[Is]++], ps...)), true)
+                : false) || ...));
+        }
+    }
+
+    std::tuple<std::vector<Ts>...> segments_;
+    std::vector<std::uint8_t> order_;
+};
+
+}  // namespace easymatch
+
+#endif  // EASY_MATCH_POLY_VECTOR_HPP_
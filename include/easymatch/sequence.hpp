@@ -0,0 +1,310 @@
+/*
+ *  Copyright (c) 2023 Yosh31207
+ *  Distributed Under The Apache-2.0 License
+ */
+
+#ifndef EASY_MATCH_SEQUENCE_HPP_
+#define EASY_MATCH_SEQUENCE_HPP_
+
+#include "easymatch/easymatch.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace easymatch {
+
+namespace easymatch_impl {
+
+/* steps */
+
+template<typename PatternT>
+struct absent_step {
+    PatternT pattern;
+};
+
+template<typename T>
+inline constexpr bool is_absent_step_v = false;
+
+template<typename PatternT>
+inline constexpr bool is_absent_step_v<absent_step<PatternT>> = true;
+
+template<typename Step>
+constexpr auto step_condition(const Step& step) {
+    if constexpr (is_absent_step_v<Step>) {
+        return step_condition(step.pattern);
+    } else if constexpr (is_pattern_v<Step>) {
+        return step.condition;
+    } else if constexpr (is_wildcard_v<Step>) {
+        return pass;
+    } else {
+        return when(step).condition;
+    }
+}
+
+template<typename... Conditions>
+struct sequence_rule {
+    size_t window;
+    std::tuple<Conditions...> conditions;
+    std::array<bool, sizeof...(Conditions)> absent;
+};
+
+}  // namespace easymatch_impl
+
+/* absent(pattern) is a step that must not occur at its place in a sequence. */
+template<typename PatternT>
+constexpr auto absent(const PatternT& pattern) {
+    return easymatch_impl::absent_step<PatternT>{pattern};
+}
+
+/*
+ * seq(window, steps...) matches events of one key that satisfy the steps in order,
+ * with the last event at most `window` events after the first one.
+ * Other events may occur in between unless an absent(...) step forbids them.
+ */
+template<typename... Steps>
+constexpr auto seq(size_t window, const Steps&... steps) {
+    using Rule = easymatch_impl::sequence_rule<
+        easymatch_impl::remove_cvref_t<decltype(easymatch_impl::step_condition(steps))>...>;
+    return Rule{
+        window,
+        std::make_tuple(easymatch_impl::step_condition(steps)...),
+        {easymatch_impl::is_absent_step_v<Steps>...}
+    };
+}
+
+struct sequence_match {
+    size_t rule;
+    uint64_t first_position;
+    uint64_t last_position;
+};
+
+/*
+ * sequence_matcher consumes events one by one and reports completed sequences.
+ * All rules are flattened into one step table; each step is evaluated at most
+ * once per event, and state is kept only for active partial matches of each key.
+ */
+template<typename Event, typename KeyFn, typename OnMatch, typename... Rules>
+class sequence_matcher {
+public:
+    using key_type = easymatch_impl::remove_cvref_t<std::invoke_result_t<KeyFn, const Event&>>;
+
+    sequence_matcher(KeyFn key_fn, OnMatch on_match, size_t max_partials_per_key, Rules... rules)
+        : key_fn_(std::move(key_fn)),
+          on_match_(std::move(on_match)),
+          max_partials_per_key_(max_partials_per_key == 0 ? 1 : max_partials_per_key),
+          rules_(std::move(rules)...) {
+        compile(std::index_sequence_for<Rules...>{});
+        memo_.assign(steps_.size(), unknown);
+    }
+
+    /* consumes the next event. */
+    void feed(const Event& event) {
+        auto position = position_++;
+        const auto& key = key_fn_(event);
+
+        if (auto it = partials_.find(key); it != partials_.end()) {
+            advance(it->second, key, event, position);
+            if (it->second.empty()) {
+                partials_.erase(it);
+            }
+        }
+        start(key, event, position);
+
+        for (auto step : touched_) {
+            memo_[step] = unknown;
+        }
+        touched_.clear();
+    }
+
+    /* completes or drops partial matches whose window has passed; call it periodically. */
+    void expire() {
+        for (auto it = partials_.begin(); it != partials_.end();) {
+            auto& list = it->second;
+            size_t kept = 0;
+            for (auto& partial : list) {
+                if (!expire_partial(partial, it->first, position_)) {
+                    list[kept++] = partial;
+                }
+            }
+            list.resize(kept);
+            it = list.empty() ? partials_.erase(it) : std::next(it);
+        }
+    }
+
+    /* the number of partial matches being tracked. */
+    size_t active() const {
+        size_t n = 0;
+        for (const auto& [key, list] : partials_) {
+            n += list.size();
+        }
+        return n;
+    }
+
+    uint64_t position() const {
+        return position_;
+    }
+
+private:
+    using rules_type = std::tuple<Rules...>;
+    using step_fn = bool (*)(const rules_type&, const Event&);
+
+    static constexpr int8_t unknown = -1;
+
+    struct compiled_rule {
+        size_t window;
+        std::vector<uint32_t> positives;
+        std::vector<std::vector<uint32_t>> gaps;  // absent steps before each positive step, and after the last
+    };
+
+    struct partial {
+        uint32_t rule;
+        uint32_t next;
+        uint64_t first_position;
+    };
+
+    template<size_t R, size_t S>
+    static bool eval_step(const rules_type& rules, const Event& event) {
+        return static_cast<bool>(std::get<S>(std::get<R>(rules).conditions)(event));
+    }
+
+    template<size_t... Rs>
+    void compile(std::index_sequence<Rs...>) {
+        (compile_rule<Rs>(std::make_index_sequence<std::tuple_size_v<
+            decltype(std::get<Rs>(rules_).conditions)>>{}), ...);
+    }
+
+    template<size_t R, size_t... Ss>
+    void compile_rule(std::index_sequence<Ss...>) {
+        const auto& rule = std::get<R>(rules_);
+        compiled_rule compiled{rule.window, {}, {{}}};
+        size_t index = 0;
+        for (auto fn : {&eval_step<R, Ss>...}) {
+            auto step = static_cast<uint32_t>(steps_.size());
+            steps_.push_back(fn);
+            if (rule.absent[index++]) {
+                compiled.gaps.back().push_back(step);
+            } else {
+                compiled.positives.push_back(step);
+                compiled.gaps.emplace_back();
+            }
+        }
+        if (compiled.positives.empty() || !compiled.gaps.front().empty()) {
+            throw std::invalid_argument("a sequence must start with a present step");
+        }
+        compiled.gaps.erase(compiled.gaps.begin());
+        rules_info_.push_back(std::move(compiled));
+    }
+
+    bool matches(uint32_t step, const Event& event) {
+        auto& memo = memo_[step];
+        if (memo == unknown) {
+            memo = steps_[step](rules_, event) ? 1 : 0;
+            touched_.push_back(step);
+        }
+        return memo == 1;
+    }
+
+    // gaps[i] holds the absent steps that must not occur before positives[i + 1];
+    // the last gap is checked until the window closes.
+    const std::vector<uint32_t>& gap_before(const compiled_rule& rule, uint32_t next) const {
+        return rule.gaps[next - 1];
+    }
+
+    bool completed(const compiled_rule& rule, const partial& p) const {
+        return p.next == rule.positives.size();
+    }
+
+    bool expire_partial(const partial& p, const key_type& key, uint64_t position) {
+        const auto& rule = rules_info_[p.rule];
+        if (position - p.first_position <= rule.window) {
+            return false;
+        }
+        if (completed(rule, p)) {
+            on_match_(key, sequence_match{p.rule, p.first_position, p.first_position + rule.window});
+        }
+        return true;
+    }
+
+    void advance(std::vector<partial>& list, const key_type& key, const Event& event, uint64_t position) {
+        size_t kept = 0;
+        for (auto& p : list) {
+            if (expire_partial(p, key, position)) {
+                continue;
+            }
+            const auto& rule = rules_info_[p.rule];
+            bool violated = false;
+            for (auto step : gap_before(rule, p.next)) {
+                if (matches(step, event)) {
+                    violated = true;
+                    break;
+                }
+            }
+            if (violated) {
+                continue;
+            }
+            if (!completed(rule, p) && matches(rule.positives[p.next], event)) {
+                ++p.next;
+                if (completed(rule, p) && rule.gaps.back().empty()) {
+                    on_match_(key, sequence_match{p.rule, p.first_position, position});
+                    continue;
+                }
+            }
+            list[kept++] = p;
+        }
+        list.resize(kept);
+    }
+
+    void start(const key_type& key, const Event& event, uint64_t position) {
+        std::vector<partial>* list = nullptr;
+        for (uint32_t r = 0; r < rules_info_.size(); ++r) {
+            const auto& rule = rules_info_[r];
+            if (!matches(rule.positives.front(), event)) {
+                continue;
+            }
+            if (rule.positives.size() == 1 && rule.gaps.back().empty()) {
+                on_match_(key, sequence_match{r, position, position});
+                continue;
+            }
+            if (list == nullptr) {
+                list = &partials_[key];
+            }
+            if (list->size() >= max_partials_per_key_) {
+                list->erase(list->begin());
+            }
+            list->push_back(partial{r, 1, position});
+        }
+    }
+
+    KeyFn key_fn_;
+    OnMatch on_match_;
+    size_t max_partials_per_key_;
+    rules_type rules_;
+    std::vector<step_fn> steps_;
+    std::vector<compiled_rule> rules_info_;
+    std::vector<int8_t> memo_;
+    std::vector<uint32_t> touched_;
+    std::unordered_map<key_type, std::vector<partial>> partials_;
+    uint64_t position_ = 0;
+};
+
+/*
+ * make_sequence_matcher<Event>(key_fn, on_match, rules...) builds a matcher that calls
+ * on_match(key, sequence_match) for every completed rule.
+ */
+template<typename Event, typename KeyFn, typename OnMatch, typename... Rules>
+auto make_sequence_matcher(KeyFn key_fn, OnMatch on_match, Rules... rules) {
+    constexpr size_t default_max_partials_per_key = 64;
+    return sequence_matcher<Event, KeyFn, OnMatch, Rules...>(
+        std::move(key_fn), std::move(on_match), default_max_partials_per_key, std::move(rules)...);
+}
+
+}  // namespace easymatch
+
+#endif  // EASY_MATCH_SEQUENCE_HPP_
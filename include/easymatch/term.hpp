@@ -0,0 +1,367 @@
+/*
+ *  Copyright (c) 2023 Yosh31207
+ *  Distributed Under The Apache-2.0 License
+ */
+
+#ifndef EASY_MATCH_TERM_HPP_
+#define EASY_MATCH_TERM_HPP_
+
+#include "easymatch/easymatch.hpp"
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace easymatch {
+
+/*
+ * term<Ts...> is a node of a recursive variant tree.
+ * Alternatives refer to their children with `const term<Ts...>*` and list all
+ * of their members in declaration order with `auto fields() const { return std::tie(...); }`.
+ * Alternatives without children may omit fields().
+ */
+template<typename... Ts>
+struct term : std::variant<Ts...> {
+    using std::variant<Ts...>::variant;
+};
+
+namespace easymatch_impl {
+
+template<typename T>
+struct term_variant;
+
+template<typename... Ts>
+struct term_variant<term<Ts...>> {
+    using type = std::variant<Ts...>;
+};
+
+template<typename T>
+using term_variant_t = typename term_variant<T>::type;
+
+/* fields */
+
+template<typename T, typename = void>
+struct has_fields : std::false_type {};
+
+template<typename T>
+struct has_fields<T, std::void_t<decltype(std::declval<const T&>().fields())>> : std::true_type {};
+
+template<typename T>
+inline constexpr bool has_fields_v = has_fields<T>::value;
+
+template<typename Term, typename Field, typename MapFn>
+Field map_field(const Field& field, MapFn& map_fn, bool& changed) {
+    if constexpr (std::is_same_v<Field, const Term*>) {
+        auto mapped = map_fn(field);
+        changed |= mapped != field;
+        return mapped;
+    } else {
+        return field;
+    }
+}
+
+/* returns the alternative with its children mapped, or nullopt if no child changed. */
+template<typename Term, typename T, typename MapFn>
+std::optional<T> map_children(const T& x, MapFn map_fn) {
+    if constexpr (has_fields_v<T>) {
+        bool changed = false;
+        auto mapped = std::apply([&](const auto&... fields) {
+            return std::make_tuple(map_field<Term>(fields, map_fn, changed)...);
+        }, x.fields());
+        if (!changed) {
+            return std::nullopt;
+        }
+        return std::apply([](auto&&... fields) {
+            return T{std::move(fields)...};
+        }, std::move(mapped));
+    } else {
+        return std::nullopt;
+    }
+}
+
+/* hash and equality of terms whose children are already shared */
+
+inline size_t hash_combine(size_t seed, size_t value) {
+    return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+template<typename T>
+size_t shallow_hash(const T& x) {
+    static_assert(has_fields_v<T> || std::is_empty_v<T>, "hash-consed alternatives require fields()");
+    if constexpr (has_fields_v<T>) {
+        return std::apply([](const auto&... fields) {
+            size_t seed = 0;
+            ((seed = hash_combine(seed, std::hash<remove_cvref_t<decltype(fields)>>{}(fields))), ...);
+            return seed;
+        }, x.fields());
+    } else {
+        return 0;
+    }
+}
+
+template<typename T>
+bool shallow_equal(const T& lhs, const T& rhs) {
+    if constexpr (has_fields_v<T>) {
+        return lhs.fields() == rhs.fields();
+    } else {
+        return true;
+    }
+}
+
+}  // namespace easymatch_impl
+
+/*
+ * term_arena allocates terms from fixed-size chunks.
+ * Terms live until clear() or the destruction of the arena.
+ */
+template<typename Term>
+class term_arena {
+public:
+    using term_type = Term;
+
+    explicit term_arena(size_t chunk_size = 1024)
+        : chunk_size_(chunk_size == 0 ? 1 : chunk_size) {}
+
+    term_arena(const term_arena&) = delete;
+    term_arena& operator=(const term_arena&) = delete;
+
+    ~term_arena() {
+        clear();
+    }
+
+    template<typename T, typename... Args>
+    const Term* make(Args&&... args) {
+        return make(Term(std::in_place_type<T>, T{std::forward<Args>(args)...}));
+    }
+
+    const Term* make(Term value) {
+        if (chunks_.empty() || used_ == chunk_size_) {
+            chunks_.push_back(std::make_unique<slot[]>(chunk_size_));
+            used_ = 0;
+        }
+        auto node = new (&chunks_.back()[used_]) Term(std::move(value));
+        ++used_;
+        ++size_;
+        return node;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    /* destroys all terms at once. */
+    void clear() {
+        if constexpr (!std::is_trivially_destructible_v<Term>) {
+            for (size_t i = 0; i < chunks_.size(); ++i) {
+                auto count = i + 1 == chunks_.size() ? used_ : chunk_size_;
+                for (size_t j = 0; j < count; ++j) {
+                    std::launder(reinterpret_cast<Term*>(&chunks_[i][j]))->~Term();
+                }
+            }
+        }
+        chunks_.clear();
+        used_ = 0;
+        size_ = 0;
+    }
+
+private:
+    using slot = std::aligned_storage_t<sizeof(Term), alignof(Term)>;
+
+    size_t chunk_size_;
+    size_t used_ = 0;
+    size_t size_ = 0;
+    std::vector<std::unique_ptr<slot[]>> chunks_;
+};
+
+/*
+ * hash_cons_arena returns one shared node for structurally equal terms.
+ * Children are shared already, so hashing and comparing a new term only looks
+ * at its own fields, and equality of subtrees becomes pointer equality.
+ */
+template<typename Term>
+class hash_cons_arena {
+public:
+    using term_type = Term;
+
+    explicit hash_cons_arena(size_t chunk_size = 1024)
+        : terms_(chunk_size) {}
+
+    template<typename T, typename... Args>
+    const Term* make(Args&&... args) {
+        return make(Term(std::in_place_type<T>, T{std::forward<Args>(args)...}));
+    }
+
+    const Term* make(Term value) {
+        if ((terms_.size() + 1) * 2 > slots_.size()) {
+            grow();
+        }
+        auto hash = hash_of(value);
+        auto mask = slots_.size() - 1;
+        for (auto i = hash & mask;; i = (i + 1) & mask) {
+            auto& slot = slots_[i];
+            if (slot.node == nullptr) {
+                slot = {hash, terms_.make(std::move(value))};
+                return slot.node;
+            }
+            if (slot.hash == hash && equal(*slot.node, value)) {
+                return slot.node;
+            }
+        }
+    }
+
+    size_t size() const {
+        return terms_.size();
+    }
+
+    /* destroys all terms at once. */
+    void clear() {
+        terms_.clear();
+        slots_.clear();
+    }
+
+private:
+    struct slot_type {
+        size_t hash = 0;
+        const Term* node = nullptr;
+    };
+
+    using variant_type = easymatch_impl::term_variant_t<Term>;
+
+    static size_t hash_of(const Term& x) {
+        return std::visit([&](const auto& alternative) {
+            return easymatch_impl::hash_combine(x.index(), easymatch_impl::shallow_hash(alternative));
+        }, static_cast<const variant_type&>(x));
+    }
+
+    static bool equal(const Term& lhs, const Term& rhs) {
+        if (lhs.index() != rhs.index()) {
+            return false;
+        }
+        return std::visit([&](const auto& alternative) {
+            using T = easymatch_impl::remove_cvref_t<decltype(alternative)>;
+            return easymatch_impl::shallow_equal(alternative, std::get<T>(rhs));
+        }, static_cast<const variant_type&>(lhs));
+    }
+
+    void grow() {
+        auto slots = std::vector<slot_type>(slots_.empty() ? 64 : slots_.size() * 2);
+        auto mask = slots.size() - 1;
+        for (const auto& slot : slots_) {
+            if (slot.node == nullptr) {
+                continue;
+            }
+            auto i = slot.hash & mask;
+            while (slots[i].node != nullptr) {
+                i = (i + 1) & mask;
+            }
+            slots[i] = slot;
+        }
+        slots_ = std::move(slots);
+    }
+
+    term_arena<Term> terms_;
+    std::vector<slot_type> slots_;
+};
+
+/*
+ * rewriter applies match arms as rewrite rules bottom-up until nothing changes.
+ * A rule handler returns the replacing term, or nullptr (or the input) to decline.
+ * Normalized terms are remembered, so unchanged subtrees are skipped and only
+ * the spines above rewritten nodes are rebuilt.
+ */
+template<typename Arena, typename... PatternStatements>
+class rewriter {
+public:
+    using term_type = typename Arena::term_type;
+
+    explicit rewriter(Arena& arena, const PatternStatements&... rules)
+        : arena_(arena), rules_(rules...) {}
+
+    const term_type* operator()(const term_type* root) {
+        return normalize(root);
+    }
+
+    /* the number of applications of each rule, in declaration order. */
+    const std::array<size_t, sizeof...(PatternStatements)>& counts() const {
+        return counts_;
+    }
+
+    /* forgets normalized terms; required after the arena is cleared. */
+    void reset() {
+        normal_.clear();
+        counts_ = {};
+    }
+
+private:
+    const term_type* normalize(const term_type* x) {
+        if (auto it = normal_.find(x); it != normal_.end()) {
+            return it->second;
+        }
+
+        auto rebuilt = std::visit([&](const auto& alternative) -> const term_type* {
+            using T = easymatch_impl::remove_cvref_t<decltype(alternative)>;
+            auto mapped = easymatch_impl::map_children<term_type>(alternative, [&](const term_type* child) {
+                return normalize(child);
+            });
+            return mapped ? arena_.make(term_type(std::in_place_type<T>, std::move(*mapped))) : x;
+        }, static_cast<const easymatch_impl::term_variant_t<term_type>&>(*x));
+
+        auto result = rebuilt;
+        if (auto next = apply_rules(rebuilt, std::index_sequence_for<PatternStatements...>{})) {
+            result = normalize(next);
+        }
+
+        normal_[x] = result;
+        normal_[rebuilt] = result;
+        normal_[result] = result;
+        return result;
+    }
+
+    template<size_t... Is>
+    const term_type* apply_rules(const term_type* x, std::index_sequence<Is...>) {
+        const term_type* result = nullptr;
+        static_cast<void>((((result = apply_rule<Is>(x)) != nullptr) || ...));
+        return result;
+    }
+
+    template<size_t I>
+    const term_type* apply_rule(const term_type* x) {
+        const auto& rule = std::get<I>(rules_);
+        if constexpr (easymatch_impl::is_always_false_v<decltype(rule.condition(*x))>) {
+            return nullptr;
+        } else {
+            if (!rule.condition(*x)) {
+                return nullptr;
+            }
+            const term_type* result = rule.handler(rule.unwrap(*x));
+            if (result == nullptr || result == x) {
+                return nullptr;
+            }
+            ++counts_[I];
+            return result;
+        }
+    }
+
+    Arena& arena_;
+    std::tuple<PatternStatements...> rules_;
+    std::array<size_t, sizeof...(PatternStatements)> counts_{};
+    std::unordered_map<const term_type*, const term_type*> normal_;
+};
+
+template<typename Arena, typename... PatternStatements>
+auto make_rewriter(Arena& arena, const PatternStatements&... rules) {
+    return rewriter<Arena, PatternStatements...>(arena, rules...);
+}
+
+}  // namespace easymatch
+
+#endif  // EASY_MATCH_TERM_HPP_
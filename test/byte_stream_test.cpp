@@ -0,0 +1,64 @@
+#include "easymatch/byte_stream.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace easymatch;
+
+namespace {
+
+std::vector<std::pair<size_t, uint64_t>> scan(const byte_automaton& automaton, const std::vector<std::string_view>& chunks) {
+    std::vector<std::pair<size_t, uint64_t>> found;
+    byte_stream_matcher stream(automaton);
+    for (auto chunk : chunks) {
+        stream.feed(chunk, [&](const byte_match& m) { found.emplace_back(m.signature, m.offset); });
+    }
+    return found;
+}
+
+TEST(ByteStream, overlapping_signatures) {
+    byte_automaton automaton = {"he", "she", "his", "hers"};
+    EXPECT_EQ(automaton.signatures(), 4u);
+
+    auto found = scan(automaton, {"ushers"});
+    std::vector<std::pair<size_t, uint64_t>> expected = {{1, 1}, {0, 2}, {3, 2}};
+    EXPECT_EQ(found, expected);
+}
+
+TEST(ByteStream, across_chunks) {
+    byte_automaton automaton = {"GET /", "\x16\x03\x01"};
+    auto whole = scan(automaton, {"xxGET /index\x16\x03\x01yy GET /"});
+    auto split = scan(automaton, {"xxG", "ET", " /index\x16", "\x03", "\x01yy GE", "T /"});
+    EXPECT_EQ(whole, split);
+
+    std::vector<std::pair<size_t, uint64_t>> expected = {{0, 2}, {1, 12}, {0, 18}};
+    EXPECT_EQ(whole, expected);
+}
+
+TEST(ByteStream, long_input_with_prefilter) {
+    byte_automaton automaton = {"needle", "pin"};
+    std::string haystack(1000, '.');
+    haystack.replace(100, 6, "needle");
+    haystack.replace(517, 3, "pin");
+    haystack.replace(994, 6, "needle");
+
+    auto found = scan(automaton, {std::string_view(haystack).substr(0, 997), std::string_view(haystack).substr(997)});
+    std::vector<std::pair<size_t, uint64_t>> expected = {{0, 100}, {1, 517}, {0, 994}};
+    EXPECT_EQ(found, expected);
+}
+
+TEST(ByteStream, many_first_bytes) {
+    byte_automaton automaton = {"a1", "b2", "c3", "d4", "e5", "f6"};
+    auto found = scan(automaton, {"zzf6zza1zzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzze", "5"});
+    std::vector<std::pair<size_t, uint64_t>> expected = {{5, 2}, {0, 6}, {4, 45}};
+    EXPECT_EQ(found, expected);
+}
+
+TEST(ByteStream, rejects_empty_signature) {
+    EXPECT_THROW(byte_automaton({"a", ""}), std::invalid_argument);
+}
+
+}  // namespace
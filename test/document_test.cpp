@@ -0,0 +1,80 @@
+#include "easymatch/document.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <gtest/gtest.h>
+
+using namespace easymatch;
+using namespace std::string_literals;
+
+namespace {
+
+std::string route(const json_value& request) {
+    return match(request)(
+        pattern | obj(key("type", "cancel"), key("id")) = [](const json_value&, const json_value& id) {
+            return "cancel "s + std::string(std::get<std::string_view>(id));
+        },
+        pattern | obj(key("type", "order"), key("qty", _ > 0)) = [](const json_value&, const json_value& qty) {
+            return "order of "s + std::to_string(static_cast<int>(std::get<double>(qty)));
+        },
+        pattern | obj(key("type", "order")) = "empty order"s,
+        pattern | arr(_, _)                 = "pair"s,
+        pattern | _                         = "unknown"s
+    );
+}
+
+TEST(Document, route_by_shape) {
+    EXPECT_EQ(route(json_document(R"({"type": "order", "qty": 3})").root()), "order of 3");
+    EXPECT_EQ(route(json_document(R"({"qty": 3, "type": "order"})").root()), "order of 3");
+    EXPECT_EQ(route(json_document(R"({"type": "order", "qty": 0})").root()), "empty order");
+    EXPECT_EQ(route(json_document(R"({"type": "order", "qty": "3"})").root()), "empty order");
+    EXPECT_EQ(route(json_document(R"({"type": "cancel", "id": "a-1"})").root()), "cancel a-1");
+    EXPECT_EQ(route(json_document(R"([1, 2])").root()), "pair");
+    EXPECT_EQ(route(json_document(R"([1, 2, 3])").root()), "unknown");
+    EXPECT_EQ(route(json_document(R"("order")").root()), "unknown");
+}
+
+TEST(Document, strings_are_views) {
+    std::string source = R"({"name": "plain", "quoted": "a\"bé\n", "items": [null, true, -1.5e2, {}]})";
+    json_document document(source);
+    const auto& root = std::get<json_object>(document.root());
+    EXPECT_EQ(root.size(), 3u);
+
+    auto name = std::get<std::string_view>(*root.find("name"));
+    EXPECT_EQ(name, "plain");
+    EXPECT_GE(name.data(), source.data());
+    EXPECT_LT(name.data(), source.data() + source.size());
+    EXPECT_EQ(std::get<std::string_view>(*root.find("quoted")), "a\"b\xc3\xa9\n");
+
+    auto result = match(*root.find("items"))(
+        pattern | arr(nullptr, true, _ < -100, as<json_object>) = [](json_value, json_value, const json_value& x, json_object) {
+            return std::get<double>(x);
+        },
+        pattern | _ = 0.0
+    );
+    EXPECT_EQ(result, -150.0);
+    EXPECT_TRUE(*root.find("name") != 1);
+    EXPECT_FALSE(*root.find("name") < 1);
+}
+
+TEST(Document, nested_patterns) {
+    json_document document(R"({"customer": {"tier": "gold"}, "total": 120})");
+    auto discount = match(document.root())(
+        pattern | obj(key("customer", obj(key("tier", "gold"))), key("total", _ >= 100)) = 20,
+        pattern | obj(key("customer", obj(key("tier", "gold"))))                          = 10,
+        pattern | _                                                                       = 0
+    );
+    EXPECT_EQ(discount, 20);
+}
+
+TEST(Document, malformed) {
+    EXPECT_THROW(json_document("{\"a\": }"), std::invalid_argument);
+    EXPECT_THROW(json_document("[1, 2"), std::invalid_argument);
+    EXPECT_THROW(json_document("\"abc"), std::invalid_argument);
+    EXPECT_THROW(json_document("tru"), std::invalid_argument);
+    EXPECT_THROW(json_document("1 2"), std::invalid_argument);
+}
+
+}  // namespace
@@ -1,11 +1,19 @@
 #include "easymatch/easymatch.hpp"
 
+#include <algorithm>
 #include <any>
+#include <cstddef>
+#include <limits>
+#include <map>
+#include <memory>
 #include <optional>
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <tuple>
+#include <unordered_map>
 #include <variant>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -332,4 +340,673 @@ TEST(EasyMatching, simplified_match) {
     EXPECT_EQ(simplified_match(99), "otherwise");
 }
 
+TEST(EasyMatching, match_grouped) {
+    std::vector<std::variant<int, std::string, double>> events = {
+        1, "a"s, 2.5, 2, "b"s, 3, 0.5
+    };
+
+    std::stringstream ss;
+    match_grouped(events)(
+        pattern | as<int>    = [&](int x)           { ss << "i" << x << " "; },
+        pattern | as<string> = [&](const string& x) { ss << "s" << x << " "; },
+        pattern | as<double> = [&](double x)        { ss << "d" << x << " "; }
+    );
+
+    EXPECT_EQ(ss.str(), "i1 i2 i3 sa sb d2.5 d0.5 ");
+
+    // arms with runtime guards are tried per element, in order, within each group;
+    // a handler may itself run match_grouped.
+    ss.str("");
+    match_grouped(events)(
+        pattern | as<int> | (_ > 1) = [&](int x) { ss << "I" << x << " "; },
+        pattern | as<double>        = [&](double x) {
+            match_grouped(events)(
+                pattern | as<string> = [&](const string& y) { ss << y; },
+                pattern | _          = [] {}
+            );
+            ss << "D" << x << " ";
+        },
+        pattern | _                 = [&](const auto& x) { ss << "_" << x.index() << " "; }
+    );
+    EXPECT_EQ(ss.str(), "_0 I2 I3 _1 _1 abD2.5 abD0.5 ");
+}
+
+TEST(EasyMatching, match_each) {
+    std::vector<std::unique_ptr<int>> values;
+    for (int i = 0; i < 20; ++i) {
+        values.push_back(i % 5 == 0 ? nullptr : std::make_unique<int>(i));
+    }
+
+    for (size_t distance : {0, 1, 8, 100}) {
+        int sum = 0;
+        int nulls = 0;
+        match_each(values, distance)(
+            pattern | deref(_ > 10) = [&](int& x) { sum += x; },
+            pattern | deref()       = [] {},
+            pattern | _             = [&] { ++nulls; }
+        );
+        EXPECT_EQ(sum, 11 + 12 + 13 + 14 + 16 + 17 + 18 + 19);
+        EXPECT_EQ(nulls, 4);
+    }
+
+    std::vector<std::string> words = {"alpha", "beta", "gamma"};
+    std::stringstream ss;
+    match_each(words)(
+        pattern | "beta" = [&] { ss << "B"; },
+        pattern | _      = [&](const string& x) { ss << x.size(); }
+    );
+    EXPECT_EQ(ss.str(), "5B5");
+}
+
+struct Tracked {
+    int value;
+    static inline int prefetches = 0;
+};
+
+const void* payload_address(const Tracked& x) {
+    ++Tracked::prefetches;
+    return &x.value;
+}
+
+bool is_large(const Tracked& x) {
+    return x.value > 3;
+}
+
+TEST(EasyMatching, match_each_prefetches_for_dereferencing_arms) {
+    constexpr auto reads_payload = [](const auto& p) {
+        return easymatch_impl::reads_payload_v<easymatch_impl::remove_cvref_t<decltype(p.condition)>>;
+    };
+    static_assert(!reads_payload(_ > 1));
+    static_assert(!reads_payload(pattern | nullptr));
+    static_assert(reads_payload(as<int>));
+    static_assert(reads_payload(deref()));
+    static_assert(reads_payload(pattern | "beta"));
+    static_assert(reads_payload(any_of(_ < 0, deref())));
+
+    std::vector<Tracked> values = {{1}, {2}, {3}, {4}};
+    int sum = 0;
+    Tracked::prefetches = 0;
+    match_each(values)(
+        pattern | _ = [&](const Tracked& x) { sum += x.value; }
+    );
+    EXPECT_EQ(sum, 10);
+    EXPECT_EQ(Tracked::prefetches, 0);
+
+    match_each(values)(
+        pattern | when([](const Tracked& x) { return x.value > 2; }) = [&](const Tracked& x) { sum += x.value; },
+        pattern | _                                                  = [] {}
+    );
+    EXPECT_EQ(sum, 17);
+    EXPECT_EQ(Tracked::prefetches, 4);
+
+    match_each(values, 0)(
+        pattern | is_large = [&](const Tracked& x) { sum += x.value; },
+        pattern | _        = [] {}
+    );
+    EXPECT_EQ(sum, 21);
+    EXPECT_EQ(Tracked::prefetches, 4);
+
+    // a std::any is looked into with the types of the as<T> arms.
+    std::vector<std::any> boxes = {std::string(100, 'a'), 7, std::vector<int>(3)};
+    auto on_string = pattern | as<std::string> = [](const string&) {};
+    auto on_int = pattern | as<int> = [](int) {};
+    auto any_address = [&](const std::any& x) {
+        return easymatch_impl::element_payload_address(x, on_string, on_int);
+    };
+    EXPECT_EQ(any_address(boxes[0]), std::any_cast<std::string>(&boxes[0]));
+    EXPECT_EQ(any_address(boxes[1]), std::any_cast<int>(&boxes[1]));
+    EXPECT_EQ(any_address(boxes[2]), nullptr);
+
+    size_t length = 0;
+    match_each(boxes)(
+        pattern | as<std::string> = [&](const string& x) { length += x.size(); },
+        pattern | as<int>         = [&](int x) { length += static_cast<size_t>(x); },
+        pattern | _               = [] {}
+    );
+    EXPECT_EQ(length, 107u);
+}
+
+constexpr std::string_view classify_line(std::string_view line) {
+    return match(line)(
+        pattern | split(',', "GET", _, _)       = string_view("get with 3 fields"),
+        pattern | fields(',', "GET")            = string_view("get"),
+        pattern | split(", ", _, "x")           = string_view("2 fields ending with x"),
+        pattern | _                             = string_view("other")
+    );
+}
+
+TEST(EasyMatching, split) {
+    static_assert(classify_line("GET,/,1") == "get with 3 fields");
+    static_assert(classify_line("GET,/") == "get");
+    static_assert(classify_line("GET,/,1,2") == "get");
+    static_assert(classify_line("a, x") == "2 fields ending with x");
+    static_assert(classify_line("a, x, x") == "other");
+    static_assert(classify_line("") == "other");
+
+    auto swapped = match("key=value"s)(
+        pattern | split('=', _, _) = [](string_view key, string_view value) {
+            return std::string(value) + "=" + std::string(key);
+        },
+        pattern | _ = [] { return ""s; }
+    );
+    EXPECT_EQ(swapped, "value=key");
+}
+
+TEST(EasyMatching, split_stops_at_first_mismatch) {
+    int calls = 0;
+    auto counted = [&](string_view) { ++calls; return true; };
+    auto result = match(std::string_view("a,b,c,d"))(
+        pattern | split(',', "x", counted, counted, counted) = 1,
+        pattern | split(',', "a", "y", counted, counted)     = 2,
+        pattern | split(',', "a", counted, counted, counted) = 3,
+        pattern | _                                          = 4
+    );
+    EXPECT_EQ(result, 3);
+    EXPECT_EQ(calls, 3);
+}
+
+std::string classify_field(std::string_view field) {
+    return match(field)(
+        pattern | parse<int>(_ < 0)      = [](int x)    { return "negative int " + to_string(x); },
+        pattern | parse<int>(0)          = "zero"s,
+        pattern | parse<int>()           = [](int x)    { return "int " + to_string(x); },
+        pattern | parse<double>(_ > 0.0) = [](double x) { return "positive double " + to_string(x); },
+        pattern | _                      = "not a number"s
+    );
+}
+
+TEST(EasyMatching, parse) {
+    EXPECT_EQ(classify_field("-3"),    "negative int -3");
+    EXPECT_EQ(classify_field("0"),     "zero");
+    EXPECT_EQ(classify_field("42"),    "int 42");
+    EXPECT_EQ(classify_field("2.5"),   "positive double 2.500000");
+    EXPECT_EQ(classify_field("-2.5"),  "not a number");
+    EXPECT_EQ(classify_field("42abc"), "not a number");
+    EXPECT_EQ(classify_field(""),      "not a number");
+    EXPECT_EQ(classify_field("99999999999"), "positive double 99999999999.000000");
+}
+
+TEST(EasyMatching, parse_fields) {
+    auto classify = [](std::string_view row) {
+        return match(row)(
+            pattern | split(',', "order", parse<int>(_ > 0), parse<double>()) = [](string_view, int qty, double price) {
+                return qty * price;
+            },
+            pattern | _ = 0.0
+        );
+    };
+    EXPECT_EQ(classify("order,3,2.5"), 7.5);
+    EXPECT_EQ(classify("order,0,2.5"), 0.0);
+    EXPECT_EQ(classify("order,x,2.5"), 0.0);
+    EXPECT_EQ(classify("cancel,3,2.5"), 0.0);
+
+    // each field keeps its own value, and a reused buffer is parsed afresh.
+    auto sum = [](std::string_view row) {
+        return match(row)(
+            pattern | split(',', parse<int>(), parse<int>(), parse<int>(), parse<int>(), parse<int>()) =
+                [](int a, int b, int c, int d, int e) { return a + 10 * b + 100 * c + 1000 * d + 10000 * e; },
+            pattern | _ = -1
+        );
+    };
+    EXPECT_EQ(sum("1,2,3,4,5"), 54321);
+    std::string buffer = "12";
+    EXPECT_EQ(classify_field(buffer), "int 12");
+    buffer = "34";
+    EXPECT_EQ(classify_field(buffer), "int 34");
+
+    // the unwrap reuses the value the condition parsed.
+    std::string text = "12";
+    auto number = parse<int>();
+    EXPECT_TRUE(number.condition(text));
+    text[0] = '3';
+    EXPECT_EQ(number.unwrap(text), 12);
+}
+
+struct CountingLess {
+    using is_transparent = void;
+    int* calls;
+
+    template<typename L, typename R>
+    bool operator()(const L& lhs, const R& rhs) const {
+        ++*calls;
+        return std::string_view(lhs) < std::string_view(rhs);
+    }
+};
+
+TEST(EasyMatching, key) {
+    std::unordered_map<std::string, int> request = {{"qty", 3}, {"price", 10}};
+
+    auto describe = [](const auto& map) {
+        return match(map)(
+            pattern | key("qty", _ <= 0)            = [](int)   { return "empty order"s; },
+            pattern | key("qty")                    = [](int x) { return "order of " + to_string(x); },
+            pattern | has_key("cancel")             = "cancel"s,
+            pattern | _                             = "unknown"s
+        );
+    };
+    EXPECT_EQ(describe(request), "order of 3");
+    request["qty"] = 0;
+    EXPECT_EQ(describe(request), "empty order");
+    EXPECT_EQ(describe(std::unordered_map<std::string, int>{{"cancel", 1}}), "cancel");
+    EXPECT_EQ(describe(std::unordered_map<std::string, int>{}), "unknown");
+}
+
+TEST(EasyMatching, key_binds_by_reference) {
+    std::map<std::string, std::string, std::less<>> headers = {{"host", "example.com"}};
+    match(headers)(
+        pattern | key(std::string_view("host")) = [](std::string& x) { x = "example.org"; },
+        pattern | _                             = [] {}
+    );
+    EXPECT_EQ(headers["host"], "example.org");
+}
+
+TEST(EasyMatching, lookup_shares_lookups) {
+    int calls = 0;
+    std::map<std::string, int, CountingLess> fields(CountingLess{&calls});
+    for (auto name : {"a", "b", "c", "d", "e", "f", "g", "type"}) {
+        fields.emplace(name, 1);
+    }
+
+    calls = 0;
+    static_cast<void>(fields.find(std::string_view("type")));
+    auto one_find = calls;
+
+    calls = 0;
+    auto result = match(lookup(fields))(
+        pattern | key("type", 0) = 0,
+        pattern | key("type", 2) = 2,
+        pattern | key("type", 1) = 1,
+        pattern | _              = -1
+    );
+    EXPECT_EQ(result, 1);
+    EXPECT_EQ(calls, one_find);
+}
+
+TEST(EasyMatching, key_shares_lookups_on_plain_maps) {
+    int calls = 0;
+    std::map<std::string, int, CountingLess> fields(CountingLess{&calls});
+    for (auto name : {"a", "b", "c", "d", "e", "f", "g", "type"}) {
+        fields.emplace(name, 1);
+    }
+
+    calls = 0;
+    static_cast<void>(fields.find(std::string_view("type")));
+    static_cast<void>(fields.find(std::string_view("missing")));
+    auto two_finds = calls;
+
+    calls = 0;
+    auto result = match(fields)(
+        pattern | key("type", 0)     = [](int) { return 0; },
+        pattern | has_key("missing") = [] { return -2; },
+        pattern | key("type", 2)     = [](int) { return 2; },
+        pattern | key("type", _ > 0) = [](int& x) { return x; },
+        pattern | _                  = [] { return -1; }
+    );
+    EXPECT_EQ(result, 1);
+    EXPECT_EQ(calls, two_finds);
+
+    // the lookups are forgotten before the handler, so it may change the map and match it again.
+    match(fields)(
+        pattern | key("type") = [&](int&) {
+            fields.erase("type");
+            EXPECT_EQ(match(fields)(pattern | has_key("type") = 1, pattern | _ = 0), 0);
+        },
+        pattern | _ = [] { FAIL(); }
+    );
+}
+
+TEST(EasyMatching, one_of) {
+    auto classify = [](int x) {
+        return match(x)(
+            pattern | one_of(2, 3, 5, 7)   = "small prime"s,
+            pattern | one_of(100, -4, 1e6) = "listed"s,
+            pattern | _                    = "other"s
+        );
+    };
+    EXPECT_EQ(classify(5), "small prime");
+    EXPECT_EQ(classify(4), "other");
+    EXPECT_EQ(classify(-4), "listed");
+    EXPECT_EQ(classify(1000000), "listed");
+    EXPECT_EQ(classify(99), "other");
+
+    constexpr auto weekend = one_of("sat", "sun");
+    EXPECT_TRUE(weekend.condition("sun"s));
+    EXPECT_FALSE(weekend.condition("mon"s));
+}
+
+TEST(EasyMatching, one_of_range) {
+    using easymatch_impl::value_set;
+    using easymatch_impl::value_set_kind;
+
+    std::vector<int> dense;
+    for (int i = 0; i < 100; i += 3) {
+        dense.push_back(i);
+    }
+    std::vector<int> sparse = {1, 1000, 1000000, -7};
+    std::vector<int> large;
+    for (int i = 0; i < 1000; ++i) {
+        large.push_back(i * 7919);
+    }
+    EXPECT_EQ(value_set<int>(dense).kind(), value_set_kind::bitset);
+    EXPECT_EQ(value_set<int>(sparse).kind(), value_set_kind::sorted);
+    EXPECT_EQ(value_set<int>(large).kind(), value_set_kind::hashed);
+
+    for (const auto& values : {dense, sparse, large}) {
+        auto is_listed = one_of(values);
+        for (int x = -10; x < 8000000; x += 997) {
+            EXPECT_EQ(is_listed.condition(x), std::find(values.begin(), values.end(), x) != values.end());
+        }
+        for (auto x : values) {
+            EXPECT_TRUE(is_listed.condition(x));
+        }
+    }
+
+    std::vector<std::string> blocked;
+    for (int i = 0; i < 100; ++i) {
+        blocked.push_back("user-" + to_string(i));
+    }
+    EXPECT_EQ(value_set<std::string>(blocked).kind(), value_set_kind::hashed);
+    auto check = [&](std::string_view user) {
+        return match(user)(
+            pattern | one_of(blocked) = "blocked"s,
+            pattern | _               = "ok"s
+        );
+    };
+    EXPECT_EQ(check("user-42"), "blocked");
+    EXPECT_EQ(check("user-420"), "ok");
+
+    // a set of string_views stores std::strings, and can still be shared.
+    std::vector<std::string_view> views = {"red", "green", "blue"};
+    auto colours = std::make_shared<const value_set<std::string_view>>(views);
+    auto is_colour = one_of(colours);
+    EXPECT_TRUE(is_colour.condition("green"s));
+    EXPECT_TRUE(is_colour.condition(std::string_view("red")));
+    EXPECT_FALSE(is_colour.condition("grey"));
+}
+
+TEST(EasyMatching, one_of_inexact_probes) {
+    auto listed = [](auto x) {
+        return match(x)(
+            pattern | one_of(0, 3, 6) = 1,
+            pattern | _               = 0
+        );
+    };
+    EXPECT_EQ(listed(3.0), 1);
+    EXPECT_EQ(listed(3.5), 0);
+    EXPECT_EQ(listed(-0.5), 0);
+    EXPECT_EQ(listed(std::numeric_limits<double>::quiet_NaN()), 0);
+    EXPECT_EQ(listed(1e300), 0);
+    EXPECT_EQ(listed(4294967296L + 3), 0);
+    EXPECT_EQ(listed(3u), 1);
+
+    auto is_big = one_of(1u, 2000u, 3u);
+    EXPECT_FALSE(is_big.condition(-1));
+    EXPECT_FALSE(is_big.condition(4294967297L));
+    EXPECT_TRUE(is_big.condition(2000L));
+
+    auto is_half = one_of(0.5, 1.5);
+    EXPECT_TRUE(is_half.condition(0.5f));
+    EXPECT_FALSE(is_half.condition(1));
+    EXPECT_FALSE(is_half.condition(9007199254740993LL));
+
+    std::vector<int> sorted = {0, 3, 6};
+    std::vector<int> dense = {0, 1, 2, 3, 4, 5, 6};
+    std::vector<int> hashed;
+    for (int i = 0; i < 100; ++i) {
+        hashed.push_back(i * 7919 - 3);
+    }
+    for (const auto& values : {sorted, dense, hashed}) {
+        auto is_listed = one_of(values);
+        EXPECT_TRUE(is_listed.condition(values[1]));
+        EXPECT_TRUE(is_listed.condition(static_cast<double>(values[1])));
+        EXPECT_FALSE(is_listed.condition(values[1] + 0.5));
+        EXPECT_FALSE(is_listed.condition(-3.25));
+        EXPECT_FALSE(is_listed.condition(-1e300));
+        EXPECT_FALSE(is_listed.condition(static_cast<long long>(values[1]) + (1LL << 32)));
+    }
+}
+
+TEST(EasyMatching, one_of_prefilter) {
+    std::vector<uint64_t> blocked;
+    for (uint64_t i = 0; i < 10000; ++i) {
+        blocked.push_back(i * 2654435761u);
+    }
+    set_options options;
+    options.prefilter = true;
+    options.collect_stats = true;
+    auto set = std::make_shared<const value_set<uint64_t>>(blocked, options);
+    EXPECT_EQ(set->kind(), value_set_kind::hashed);
+    EXPECT_GT(set->prefilter_bytes(), 0u);
+
+    auto is_blocked = one_of(set);
+    for (auto x : blocked) {
+        EXPECT_TRUE(is_blocked.condition(x));
+    }
+    for (uint64_t x = 1; x < 100000; x += 2) {
+        static_cast<void>(is_blocked.condition(x * 2654435761u + 1));
+    }
+
+    auto stats = set->stats();
+    EXPECT_EQ(stats.lookups, 10000u + 50000u);
+    EXPECT_EQ(stats.rejected + stats.false_positives, 50000u);
+    EXPECT_LT(stats.false_positive_rate(), 0.01);
+
+    options.prefilter_max_bytes = 0;
+    EXPECT_EQ(value_set<uint64_t>(blocked, options).prefilter_bytes(), 32u);
+    EXPECT_EQ(value_set<uint64_t>(blocked).prefilter_bytes(), 0u);
+}
+
+TEST(EasyMatching, boolean_combinators) {
+    auto classify = [](int x) {
+        return match(x)(
+            pattern | any_of(2, 3, 5, 7)                 = "small prime"s,
+            pattern | all_of(_ > 10, _ < 20, not_(15))   = "teen"s,
+            pattern | any_of(_ < 0, 100, _ >= 1000)      = "outlier"s,
+            pattern | not_(any_of(_ < 0, _ > 9))         = "digit"s,
+            pattern | _                                  = "other"s
+        );
+    };
+    EXPECT_EQ(classify(3), "small prime");
+    EXPECT_EQ(classify(12), "teen");
+    EXPECT_EQ(classify(15), "other");
+    EXPECT_EQ(classify(-5), "outlier");
+    EXPECT_EQ(classify(100), "outlier");
+    EXPECT_EQ(classify(1000), "outlier");
+    EXPECT_EQ(classify(999), "other");
+    EXPECT_EQ(classify(4), "digit");
+
+    auto is_even = [](int x) { return x % 2 == 0; };
+    EXPECT_TRUE(any_of(is_even, 3).condition(3));
+    EXPECT_FALSE(not_(all_of(is_even, _ > 2)).condition(4));
+    EXPECT_TRUE(not_(not_(as<int>)).condition(1));
+}
+
+struct Version {
+    int number;
+};
+
+// only int < Version is defined, so t < _ must not be evaluated as _ > t.
+bool operator<(int lhs, const Version& rhs) {
+    return lhs < rhs.number;
+}
+
+TEST(EasyMatching, comparisons_keep_operand_order) {
+    auto newer_than_10 = [](Version v) {
+        return match(v)(
+            pattern | (10 < _) = 1,
+            pattern | _        = 0
+        );
+    };
+    EXPECT_EQ(newer_than_10(Version{20}), 1);
+    EXPECT_EQ(newer_than_10(Version{5}), 0);
+    EXPECT_TRUE(not_(10 < _).condition(Version{5}));
+    EXPECT_FALSE(not_(not_(10 < _)).condition(Version{5}));
+
+    static_assert((3 < _).condition(4) && !(3 < _).condition(3));
+    static_assert(not_(3 <= _).condition(2) && !not_(3 <= _).condition(3));
+    constexpr auto mirrored = any_of(3 > _, 10 <= _);
+    static_assert(mirrored.condition.size() == 2);
+    static_assert(mirrored.condition(2) && !mirrored.condition(5) && mirrored.condition(10));
+}
+
+TEST(EasyMatching, boolean_combinators_lowering) {
+    using namespace easymatch_impl;
+
+    // literal disjunctions become sets, comparison unions become merged ranges.
+    static_assert(std::is_same_v<decltype(any_of(1, 2, 3).condition), set_condition<fixed_set<int, 3>>>);
+    constexpr auto ranges = any_of(_ < 0, _ <= 5, 10, _ > 10, _ >= 100);
+    static_assert(ranges.condition.size() == 2);
+    static_assert(ranges.condition(-1) && ranges.condition(5) && !ranges.condition(6));
+    static_assert(ranges.condition(10) && ranges.condition(11) && !ranges.condition(9));
+
+    // bounds of different types are not converted to a common type, which could change them.
+    static_assert(std::is_same_v<decltype(any_of(_ < 5, _ == 100u).condition),
+                                 any_condition<comparison_condition<std::less<>, int>,
+                                               comparison_condition<std::equal_to<>, unsigned>>>);
+    auto mixed = any_of(_ < 5, _ == 100u);
+    EXPECT_TRUE(mixed.condition(-1));
+    EXPECT_TRUE(mixed.condition(100));
+    EXPECT_FALSE(mixed.condition(7));
+
+    // negations are pushed down to comparisons, and cancel out.
+    using Negated = decltype(not_(all_of(_ < 3, _ != 7)).condition);
+    static_assert(std::is_same_v<Negated, any_condition<comparison_condition<negated<std::less<>>, int>,
+                                                        comparison_condition<negated<std::not_equal_to<>>, int>>>);
+    static_assert(std::is_same_v<decltype(not_(not_(_ > 1)).condition), comparison_condition<std::greater<>, int>>);
+    static_assert(not_(_ < 3).condition(3) && !not_(_ < 3).condition(2));
+
+    // the operator is inverted only for integer subjects, because of NaN.
+    constexpr auto nan = std::numeric_limits<double>::quiet_NaN();
+    EXPECT_TRUE(not_(_ < 1.0).condition(nan));
+    EXPECT_TRUE(not_(_ < 1).condition(nan));
+    EXPECT_FALSE(not_(_ >= 1).condition(1.5));
+    auto not_less = [](auto x) {
+        return match(x)(
+            pattern | not_(_ < 1) = 1,
+            pattern | _           = 0
+        );
+    };
+    EXPECT_EQ(not_less(nan), 1);
+    EXPECT_EQ(not_less(0.5), 0);
+    EXPECT_EQ(not_less(1), 1);
+
+    // a type with only < and == needs no other operator to be negated.
+    struct Version {
+        int number;
+        bool operator<(const Version& other) const { return number < other.number; }
+        bool operator==(const Version& other) const { return number == other.number; }
+    };
+    auto not_old = not_(any_of(_ < Version{3}, Version{7}));
+    EXPECT_TRUE(not_old.condition(Version{4}));
+    EXPECT_FALSE(not_old.condition(Version{7}));
+    EXPECT_FALSE(not_old.condition(Version{2}));
+}
+
+struct Counted {
+    static inline int copies = 0;
+    static inline int moves = 0;
+
+    Counted() = default;
+    Counted(const Counted&) { ++copies; }
+    Counted(Counted&&) noexcept { ++moves; }
+    Counted& operator=(const Counted&) = default;
+    Counted& operator=(Counted&&) = default;
+
+    static void reset() {
+        copies = 0;
+        moves = 0;
+    }
+};
+
+TEST(EasyMatching, moves_payload_into_handler) {
+    using Message = std::variant<std::vector<std::byte>, int>;
+    Message message = std::vector<std::byte>(1 << 20);
+    const std::byte* buffer = std::get<0>(message).data();
+    const std::byte* received = nullptr;
+    match(std::move(message))(
+        pattern | as<std::vector<std::byte>> = [&](std::vector<std::byte> x) { received = x.data(); },
+        pattern | as<int>                    = [] {}
+    );
+    EXPECT_EQ(received, buffer);
+    EXPECT_TRUE(std::get<0>(message).empty());
+}
+
+TEST(EasyMatching, unwraps_keep_value_category) {
+    std::variant<Counted, int> v;
+    Counted::reset();
+    match(v)(
+        pattern | as<Counted> = [](const Counted&) {},
+        pattern | _           = [] {}
+    );
+    EXPECT_EQ(Counted::copies + Counted::moves, 0);
+
+    match(std::move(v))(
+        pattern | as<Counted> = [](Counted) {},
+        pattern | _           = [] {}
+    );
+    EXPECT_EQ(Counted::copies, 0);
+    EXPECT_EQ(Counted::moves, 1);
+
+    Counted::reset();
+    std::optional<std::variant<Counted, int>> o(std::in_place);
+    match(std::move(o))(
+        pattern | some | as<Counted> = [](Counted) {},
+        pattern | _                  = [] {}
+    );
+    EXPECT_EQ(Counted::copies, 0);
+    EXPECT_EQ(Counted::moves, 1);
+
+    Counted::reset();
+    std::any a = Counted();
+    match(std::move(a))(
+        pattern | as<Counted> = [](Counted) {},
+        pattern | _           = [] {}
+    );
+    EXPECT_EQ(Counted::copies, 0);
+
+    Counted::reset();
+    std::tuple<Counted, int> t;
+    match(std::move(t))(
+        pattern | ds(_, 1) = [](Counted, int) {},
+        pattern | ds(_, _) = [](Counted, int x) { EXPECT_EQ(x, 0); }
+    );
+    EXPECT_EQ(Counted::copies, 0);
+    EXPECT_EQ(Counted::moves, 1);
+}
+
+TEST(EasyMatching, composed_unwrap_owns_temporaries) {
+    // the fields and the number are made by the inner unwraps and must outlive them.
+    auto r = match("key,7"s)(
+        pattern | split(',', _, _) | ds("key", _) = [](string_view k, string_view v) { return string(k) + string(v); },
+        pattern | _                               = ""s
+    );
+    EXPECT_EQ(r, "key7");
+    EXPECT_EQ(match("42"s)(
+        pattern | parse<int>() | (_ > 3) = [](int x) { return x; },
+        pattern | _                      = 0
+    ), 42);
+}
+
+TEST(EasyMatching, multiple_values_keep_value_category) {
+    string text(100, 'x');
+    const char* buffer = text.data();
+    Counted kept;
+    Counted::reset();
+    match(std::move(text), 7, kept, Counted())(
+        pattern | ds(_, 1, _, _) = [](string, int, Counted, Counted) { FAIL(); },
+        pattern | ds(_, 7, _, _) = [&](string s, int, const Counted&, Counted) { EXPECT_EQ(s.data(), buffer); }
+    );
+    EXPECT_TRUE(text.empty());
+    EXPECT_EQ(Counted::copies, 0);
+    EXPECT_EQ(Counted::moves, 1);
+
+    // lvalues stay lvalues: a by-value parameter copies them.
+    string name = "name";
+    match(name, kept)(
+        pattern | _ = [](string s, Counted) { EXPECT_EQ(s, "name"); }
+    );
+    EXPECT_EQ(name, "name");
+    EXPECT_EQ(Counted::copies, 1);
+}
+
 }  // namespace
@@ -0,0 +1,90 @@
+#include "easymatch/loop.hpp"
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace easymatch;
+
+namespace {
+
+enum class Op : uint8_t { push, add, mul, dup, halt };
+
+struct Instr {
+    Op op;
+    long operand;
+};
+
+long run(const std::vector<Instr>& code) {
+    std::vector<long> stack;
+    size_t pc = 0;
+    long operand = 0;
+    auto fetch = [&] {
+        operand = code[pc].operand;
+        return code[pc++].op;
+    };
+    match_loop(fetch)(
+        pattern | Op::push = [&] { stack.push_back(operand); },
+        pattern | Op::add  = [&] { auto b = stack.back(); stack.pop_back(); stack.back() += b; },
+        pattern | Op::mul  = [&] { auto b = stack.back(); stack.pop_back(); stack.back() *= b; },
+        pattern | Op::dup  = [&] { stack.push_back(stack.back()); },
+        pattern | Op::halt = stop_loop
+    );
+    return stack.back();
+}
+
+TEST(MatchLoop, bytecode) {
+    std::vector<Instr> code = {
+        {Op::push, 3}, {Op::push, 4}, {Op::add, 0}, {Op::dup, 0}, {Op::mul, 0}, {Op::halt, 0}
+    };
+    EXPECT_EQ(run(code), 49);
+    EXPECT_EQ(run({{Op::push, 5}, {Op::halt, 0}, {Op::push, 6}}), 5);
+}
+
+TEST(MatchLoop, stop_from_handler) {
+    std::vector<int> values = {1, 2, -3, 40, 0, 7};
+    size_t i = 0;
+    int sum = 0;
+    std::string seen;
+    match_loop([&] { return values[i++]; })(
+        pattern | (_ < 0) = [&](int x) { sum += x; seen += "n"; },
+        pattern | 0       = [&](int) { seen += "z"; return stop_loop; },
+        pattern | (_ > 9) = [&](int x) { sum += x; seen += "b"; },
+        pattern | _       = [&](int x) { sum += x; seen += "s"; }
+    );
+    EXPECT_EQ(sum, 40);
+    EXPECT_EQ(seen, "ssnbz");
+    EXPECT_EQ(i, 5u);
+}
+
+TEST(MatchLoop, string_values) {
+    std::vector<std::string> words = {"a", "bb", "ccc", "end", "dd"};
+    size_t i = 0;
+    size_t length = 0;
+    match_loop([&] { return words[i++]; })(
+        pattern | "end" = stop_loop,
+        pattern | _     = [&](const std::string& x) { length += x.size(); }
+    );
+    EXPECT_EQ(length, 6u);
+}
+
+TEST(MatchLoop, unmatched) {
+    std::vector<uint8_t> bytes = {1, 1, 2, 9};
+    size_t i = 0;
+    int ones = 0;
+    EXPECT_THROW(
+        match_loop([&] { return bytes[i++]; })(
+            pattern | 1 = [&] { ++ones; },
+            pattern | 2 = [&] {},
+            pattern | 0 = stop_loop
+        ),
+        std::runtime_error
+    );
+    EXPECT_EQ(ones, 2);
+    EXPECT_EQ(i, 4u);
+}
+
+}  // namespace
@@ -0,0 +1,115 @@
+#include "easymatch/mailbox.hpp"
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace easymatch;
+
+namespace {
+
+struct Tick {
+    int value;
+};
+
+struct Text {
+    std::string value;
+};
+
+using Message = std::variant<Tick, Text, std::unique_ptr<int>>;
+
+TEST(Mailbox, push_and_drain) {
+    mailbox<Message> box(8);
+    EXPECT_EQ(box.capacity(), 8u);
+
+    EXPECT_TRUE(box.try_push(Tick{1}));
+    EXPECT_TRUE(box.try_push(Text{"a"}));
+    EXPECT_TRUE(box.try_push(std::make_unique<int>(3)));
+
+    int ticks = 0;
+    std::string texts;
+    int pointers = 0;
+    auto dispatch = matcher(
+        pattern | as<Tick> = [&](const Tick& x) { ticks += x.value; },
+        pattern | as<Text> = [&](const Text& x) { texts += x.value; },
+        pattern | _        = [&] { ++pointers; }
+    );
+
+    EXPECT_EQ(box.drain(dispatch), 3u);
+    EXPECT_EQ(box.drain(dispatch), 0u);
+    EXPECT_EQ(ticks, 1);
+    EXPECT_EQ(texts, "a");
+    EXPECT_EQ(pointers, 1);
+    EXPECT_EQ(box.stats().messages, 3u);
+    EXPECT_EQ(box.stats().batches, 1u);
+}
+
+TEST(Mailbox, bounded) {
+    mailbox<Message> box(4);
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(box.try_push(Tick{i}));
+    }
+    EXPECT_FALSE(box.try_push(Tick{4}));
+
+    int sum = 0;
+    auto dispatch = matcher(
+        pattern | as<Tick> = [&](const Tick& x) { sum += x.value; },
+        pattern | _        = [] {}
+    );
+    EXPECT_EQ(box.drain(dispatch, 3), 3u);
+    EXPECT_TRUE(box.try_push(Tick{10}));
+    EXPECT_EQ(box.drain(dispatch), 2u);
+    EXPECT_EQ(sum, 0 + 1 + 2 + 3 + 10);
+}
+
+TEST(Mailbox, handler_failure_consumes_message) {
+    mailbox<Message> box(4);
+    box.push(Tick{1});
+    box.push(Tick{2});
+
+    auto failing = matcher(
+        pattern | as<Tick> | when([](const Tick& x) { return x.value == 1; }) = [] { throw std::runtime_error("fail"); },
+        pattern | _ = [] {}
+    );
+    EXPECT_THROW(box.drain(failing), std::runtime_error);
+    EXPECT_EQ(box.drain(failing), 1u);
+}
+
+TEST(Mailbox, many_producers) {
+    constexpr int producers = 4;
+    constexpr int per_producer = 20000;
+    mailbox<Message> box(256);
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&box] {
+            for (int i = 1; i <= per_producer; ++i) {
+                box.push(Tick{i});
+            }
+        });
+    }
+
+    long long sum = 0;
+    long long received = 0;
+    auto dispatch = matcher(
+        pattern | as<Tick> = [&](const Tick& x) { sum += x.value; ++received; },
+        pattern | _        = [] {}
+    );
+    while (received < producers * per_producer) {
+        if (box.drain(dispatch) == 0) {
+            std::this_thread::yield();
+        }
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(sum, producers * (static_cast<long long>(per_producer) * (per_producer + 1) / 2));
+}
+
+}  // namespace
@@ -0,0 +1,120 @@
+#include "easymatch/metrics.hpp"
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include <gtest/gtest.h>
+
+using namespace easymatch;
+using namespace std::string_literals;
+
+namespace {
+
+TEST(Metrics, histogram_percentiles) {
+    latency_histogram h;
+    EXPECT_EQ(h.percentile(50), 0);
+    for (uint64_t i = 1; i <= 10000; ++i) {
+        h.record(i);
+    }
+    EXPECT_EQ(h.count(), 10000);
+    EXPECT_EQ(h.min(), 1);
+    EXPECT_EQ(h.max(), 10000);
+    EXPECT_DOUBLE_EQ(h.mean(), 5000.5);
+    EXPECT_EQ(h.percentile(0), 1);
+    EXPECT_EQ(h.percentile(100), 10000);
+    EXPECT_NEAR(static_cast<double>(h.percentile(50)), 5000, 5000 * 0.04);
+    EXPECT_NEAR(static_cast<double>(h.percentile(99)), 9900, 9900 * 0.04);
+
+    latency_histogram large;
+    large.record(UINT64_MAX);
+    EXPECT_EQ(large.percentile(50), UINT64_MAX);
+
+    // the portable bucket index agrees with the compiler's.
+    for (unsigned bit = 0; bit < 64; ++bit) {
+        uint64_t value = uint64_t(1) << bit;
+        EXPECT_EQ(easymatch_impl::highest_bit_portable(value), bit);
+        EXPECT_EQ(easymatch_impl::highest_bit_portable(value | (value >> 1) | 1), bit);
+        EXPECT_EQ(easymatch_impl::highest_bit(value | 1), bit);
+    }
+}
+
+TEST(Metrics, histogram_merge) {
+    latency_histogram a;
+    latency_histogram b;
+    for (uint64_t i = 0; i < 100; ++i) {
+        a.record(10);
+        b.record(1000);
+    }
+    auto snapshot = a;
+    a.merge(b);
+    EXPECT_EQ(a.count(), 200);
+    EXPECT_EQ(a.percentile(25), 10);
+    EXPECT_NEAR(static_cast<double>(a.percentile(75)), 1000, 1000 * 0.04);
+    EXPECT_EQ(snapshot.count(), 100);
+    a.reset();
+    EXPECT_EQ(a.count(), 0);
+}
+
+TEST(Metrics, timed_match) {
+    match_metrics<3> metrics;
+    auto classify = [&](int x) {
+        return timed_match(metrics, x)(
+            pattern | 0         = "zero"s,
+            pattern | (_ < 0)   = "negative"s,
+            pattern | _         = [](int x) { return std::to_string(x); }
+        );
+    };
+    EXPECT_EQ(classify(0), "zero");
+    EXPECT_EQ(classify(-1), "negative");
+    EXPECT_EQ(classify(-2), "negative");
+    EXPECT_EQ(classify(7), "7");
+
+    EXPECT_EQ(metrics.arms[0].guard.count(), 4);
+    EXPECT_EQ(metrics.arms[0].handler.count(), 1);
+    EXPECT_EQ(metrics.arms[1].guard.count(), 3);
+    EXPECT_EQ(metrics.arms[1].handler.count(), 2);
+    EXPECT_EQ(metrics.arms[2].handler.count(), 1);
+
+    auto total = metrics;
+    total.merge(metrics);
+    EXPECT_EQ(total.arms[1].handler.count(), 4);
+
+    int calls = 0;
+    timed_match(metrics, 5)(
+        pattern | _ = [&](int) { ++calls; }
+    );
+    EXPECT_EQ(calls, 1);
+    EXPECT_THROW(timed_match(metrics, 5)(pattern | 0 = 1), std::runtime_error);
+}
+
+TEST(Metrics, sampled_match) {
+    sampled_metrics<2> site(10);
+    long negatives = 0;
+    for (int i = 0; i < 10000; ++i) {
+        negatives += sampled_match(site, i % 4 - 1)(
+            pattern | (_ < 0) = 1,
+            pattern | _       = 0
+        );
+    }
+    EXPECT_EQ(negatives, 2500);
+    EXPECT_GT(site.samples(), 800);
+    EXPECT_LT(site.samples(), 1200);
+    EXPECT_EQ(site.evaluations(0), site.samples());
+    EXPECT_EQ(site.evaluations(1), site.hits(1));
+    EXPECT_EQ(site.hits(0) + site.hits(1), site.samples());
+    EXPECT_EQ(site.total().count(), site.samples());
+
+    auto snapshot = site;
+    snapshot.merge(site);
+    EXPECT_EQ(snapshot.samples(), 2 * site.samples());
+    EXPECT_EQ(snapshot.latency(0).count(), 2 * site.hits(0));
+
+    sampled_metrics<1> every(1);
+    for (int i = 0; i < 5; ++i) {
+        sampled_match(every, i)(pattern | _ = [](int) {});
+    }
+    EXPECT_EQ(every.samples(), 5);
+}
+
+}  // namespace
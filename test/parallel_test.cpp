@@ -0,0 +1,216 @@
+#include "easymatch/parallel.hpp"
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+#include <gtest/gtest.h>
+
+using namespace easymatch;
+
+namespace {
+
+struct Num;
+struct Add;
+struct Mul;
+using Expr = std::variant<Num, Add, Mul>;
+
+struct Num {
+    long value;
+};
+
+struct Add {
+    std::shared_ptr<Expr> lhs;
+    std::shared_ptr<Expr> rhs;
+};
+
+struct Mul {
+    std::shared_ptr<Expr> lhs;
+    std::shared_ptr<Expr> rhs;
+};
+
+std::shared_ptr<Expr> make_tree(int depth, long& leaves) {
+    if (depth == 0) {
+        ++leaves;
+        return std::make_shared<Expr>(Num{1});
+    }
+    auto lhs = make_tree(depth - 1, leaves);
+    auto rhs = make_tree(depth - 1, leaves);
+    return std::make_shared<Expr>(Add{lhs, rhs});
+}
+
+const auto eval = [](auto& self, const Expr& e) -> long {
+    return match(e)(
+        pattern | as<Num> = [](const Num& x) { return x.value; },
+        pattern | as<Add> = [&](const Add& x) {
+            auto [lhs, rhs] = self.fork(*x.lhs, *x.rhs);
+            return lhs + rhs;
+        },
+        pattern | as<Mul> = [&](const Mul& x) {
+            return self(*x.lhs) * self(*x.rhs);
+        }
+    );
+};
+
+TEST(ParallelFold, sum) {
+    long leaves = 0;
+    auto tree = make_tree(16, leaves);
+
+    work_stealing_pool pool(4);
+    EXPECT_EQ(parallel_fold<long>(pool, *tree, eval), leaves);
+    EXPECT_EQ(parallel_fold<long>(pool, *tree, eval, 0), leaves);
+}
+
+TEST(ParallelFold, nested_serial) {
+    auto two = std::make_shared<Expr>(Num{2});
+    auto three = std::make_shared<Expr>(Num{3});
+    auto product = std::make_shared<Expr>(Mul{two, three});
+    auto root = Expr(Add{product, two});
+
+    work_stealing_pool pool(2);
+    EXPECT_EQ(parallel_fold<long>(pool, root, eval), 8);
+}
+
+TEST(ParallelFold, propagates_exception) {
+    long leaves = 0;
+    auto tree = make_tree(8, leaves);
+
+    auto failing = [](auto& self, const Expr& e) -> long {
+        return match(e)(
+            pattern | as<Num> = [](const Num&) -> long { throw std::runtime_error("leaf"); },
+            pattern | as<Add> = [&](const Add& x) {
+                auto [lhs, rhs] = self.fork(*x.lhs, *x.rhs);
+                return lhs + rhs;
+            },
+            pattern | _ = [] { return 0L; }
+        );
+    };
+
+    work_stealing_pool pool(3);
+    EXPECT_THROW(parallel_fold<long>(pool, *tree, failing), std::runtime_error);
+}
+
+TEST(BatchExecutor, map_in_input_order) {
+    std::vector<int> input(100000);
+    for (size_t i = 0; i < input.size(); ++i) {
+        input[i] = static_cast<int>(i);
+    }
+
+    batch_options options;
+    options.threads = 4;
+    options.min_chunk = 1;
+    batch_executor executor(options);
+    EXPECT_EQ(executor.size(), 4u);
+
+    auto classify = matcher(
+        pattern | (_ < 0)         = std::string("negative"),
+        pattern | one_of(2, 3, 5) = std::string("prime"),
+        pattern | _               = std::string("other")
+    );
+    for (int run = 0; run < 3; ++run) {
+        auto result = executor.map(input, classify).to_vector();
+        ASSERT_EQ(result.size(), input.size());
+        EXPECT_EQ(result[3], "prime");
+        EXPECT_EQ(result[4], "other");
+
+        uint64_t elements = 0;
+        for (const auto& s : executor.stats()) {
+            elements += s.elements;
+            EXPECT_LE(s.busy_ns, s.wall_ns);
+        }
+        EXPECT_EQ(elements, input.size());
+    }
+}
+
+// the first core this process may run on
+int allowed_core() {
+#if defined(__linux__)
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        for (int core = 0; core < CPU_SETSIZE; ++core) {
+            if (CPU_ISSET(core, &allowed)) {
+                return core;
+            }
+        }
+    }
+#endif
+    return 0;
+}
+
+TEST(BatchExecutor, pinned_workers) {
+    static_assert(alignof(worker_stats) == easymatch_impl::cache_line_size);
+    static_assert(alignof(batch_result<int>::arena) == easymatch_impl::cache_line_size);
+
+    auto core = allowed_core();
+    batch_options options;
+    options.cores = {core, core};
+    batch_executor executor(options);
+    EXPECT_EQ(executor.size(), 2u);
+
+    std::vector<int> input(1000, 1);
+    long sum = 0;
+    auto result = executor.map(input, [](int x) { return x * 2; });
+    result.for_each([&](size_t, int x) { sum += x; });
+    EXPECT_EQ(sum, 2000);
+#if defined(__linux__)
+    for (const auto& s : executor.stats()) {
+        EXPECT_EQ(s.core, core);
+    }
+#endif
+}
+
+TEST(BatchExecutor, invalid_cores_stay_unpinned) {
+    batch_options options;
+    options.cores = {-1, 1 << 20};
+    batch_executor executor(options);
+    std::vector<int> input(100, 1);
+    executor.for_each(input, [](int) {});
+    for (const auto& s : executor.stats()) {
+        EXPECT_EQ(s.core, -1);
+    }
+}
+
+TEST(BatchExecutor, concurrent_callers) {
+    batch_executor executor(batch_options{{}, 2});
+    std::vector<int> input(10000, 1);
+    std::vector<long> sums(4);
+    std::vector<std::thread> callers;
+    for (size_t t = 0; t < sums.size(); ++t) {
+        callers.emplace_back([&, t] {
+            for (int run = 0; run < 10; ++run) {
+                executor.map(input, [](int x) { return x; }).for_each([&](size_t, int x) { sums[t] += x; });
+            }
+        });
+    }
+    for (auto& caller : callers) {
+        caller.join();
+    }
+    for (auto sum : sums) {
+        EXPECT_EQ(sum, 100000);
+    }
+}
+
+TEST(BatchExecutor, rethrows) {
+    batch_executor executor(batch_options{{}, 3});
+    std::vector<int> input(1000);
+    auto throw_at_500 = [](int x) {
+        if (x == 500) {
+            throw std::runtime_error("bad element");
+        }
+    };
+    for (size_t i = 0; i < input.size(); ++i) {
+        input[i] = static_cast<int>(i);
+    }
+    EXPECT_THROW(executor.for_each(input, throw_at_500), std::runtime_error);
+    EXPECT_NO_THROW(executor.for_each(input, [](int) {}));
+}
+
+}  // namespace
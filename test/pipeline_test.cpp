@@ -0,0 +1,173 @@
+#include "easymatch/pipeline.hpp"
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace easymatch;
+using namespace std::string_literals;
+
+namespace {
+
+struct Trade {
+    long id;
+    long quantity;
+};
+
+struct Heartbeat {};
+
+using Message = std::variant<Trade, Heartbeat>;
+
+TEST(Pipeline, stages_in_order) {
+    std::vector<std::string> received;
+    auto p = make_pipeline<long>(8, 4,
+        [](long x) -> Message {
+            return x % 3 == 0 ? Message(Heartbeat{}) : Message(Trade{x, x * 10});
+        },
+        matcher(
+            pattern | as<Trade>     = [](const Trade& x) { return "trade " + std::to_string(x.id); },
+            pattern | as<Heartbeat> = "heartbeat"s
+        ),
+        [](std::string x) { return x + "!"; },
+        [&](std::string x) { received.push_back(std::move(x)); }
+    );
+    for (long i = 0; i < 1000; ++i) {
+        p->push(i);
+    }
+    p->close();
+
+    ASSERT_EQ(received.size(), 1000u);
+    EXPECT_EQ(received[0], "heartbeat!");
+    EXPECT_EQ(received[1], "trade 1!");
+    EXPECT_EQ(received[999], "heartbeat!");
+
+    auto stats = p->stats();
+    EXPECT_EQ(stats.size(), 4u);
+    for (const auto& s : stats) {
+        EXPECT_EQ(s.items, 1000u);
+        EXPECT_GE(s.batches, 250u);
+    }
+}
+
+TEST(Pipeline, backpressure_keeps_items) {
+    std::string joined;
+    auto p = make_pipeline<std::string>(2, 1,
+        [](std::string x) { return x + x; },
+        [&](std::string x) { joined += x; }
+    );
+    for (int i = 0; i < 100; ++i) {
+        p->push(std::string(20, static_cast<char>('a' + i % 26)));
+    }
+    p->close();
+    EXPECT_EQ(joined.size(), 100u * 40u);
+    EXPECT_EQ(joined.substr(0, 41), std::string(40, 'a') + "b");
+}
+
+TEST(Pipeline, failed_stage) {
+    long sunk = 0;
+    auto p = make_pipeline<long>(4, 2,
+        [](long x) {
+            if (x == 10) {
+                throw std::invalid_argument("bad item");
+            }
+            return x;
+        },
+        [&](long) { ++sunk; }
+    );
+    EXPECT_THROW({
+        for (long i = 0; i < 1000; ++i) {
+            p->push(i);
+        }
+        p->close();
+    }, std::exception);
+    EXPECT_LE(sunk, 10);
+}
+
+struct Tracked {
+    static inline std::atomic<int> live{0};
+    static inline std::atomic<int> destroyed_twice{0};
+    long value;
+    bool alive = true;
+
+    explicit Tracked(long x) : value(x) { ++live; }
+    Tracked(Tracked&& other) noexcept : value(other.value) { ++live; }
+    Tracked(const Tracked& other) : value(other.value) { ++live; }
+    Tracked& operator=(const Tracked&) = default;
+
+    ~Tracked() {
+        if (!alive) {
+            ++destroyed_twice;
+        }
+        alive = false;
+        --live;
+    }
+};
+
+TEST(Pipeline, failed_stage_destroys_items_once) {
+    {
+        auto p = make_pipeline<Tracked>(16, 8,
+            [](Tracked x) {
+                if (x.value == 3) {
+                    throw std::invalid_argument("bad item");
+                }
+                return x;
+            },
+            [](Tracked) {}
+        );
+        EXPECT_THROW({
+            for (long i = 0; i < 100; ++i) {
+                p->push(Tracked(i));
+            }
+            p->close();
+        }, std::exception);
+    }
+    EXPECT_EQ(Tracked::live, 0);
+    EXPECT_EQ(Tracked::destroyed_twice, 0);
+
+    {
+        spsc_ring<Tracked> ring(8);
+        for (long i = 0; i < 6; ++i) {
+            EXPECT_TRUE(ring.try_push(Tracked(i)));
+        }
+        long seen = 0;
+        EXPECT_THROW(ring.consume(6, [&](Tracked&& x) {
+            if (x.value == 3) {
+                throw std::invalid_argument("bad item");
+            }
+            seen += 1;
+        }), std::invalid_argument);
+        EXPECT_EQ(seen, 3);
+        EXPECT_EQ(Tracked::live, 2);
+
+        // the item that threw counts as consumed.
+        EXPECT_EQ(ring.consume(6, [&](Tracked&& x) { seen += x.value; }), 2u);
+        EXPECT_EQ(seen, 3 + 4 + 5);
+        EXPECT_TRUE(ring.try_push(Tracked(6)));
+    }
+    EXPECT_EQ(Tracked::live, 0);
+    EXPECT_EQ(Tracked::destroyed_twice, 0);
+}
+
+TEST(Pipeline, spsc_ring_batches) {
+    spsc_ring<std::string> ring(4);
+    EXPECT_EQ(ring.capacity(), 4u);
+
+    std::vector<std::string> items = {"a", "b", "c", "d", "e"};
+    EXPECT_EQ(ring.push_batch(items.begin(), items.end()), 4u);
+    EXPECT_FALSE(ring.try_push("f"));
+
+    std::string consumed;
+    EXPECT_EQ(ring.consume(3, [&](std::string&& x) { consumed += x; }), 3u);
+    EXPECT_TRUE(ring.try_push("f"));
+    ring.close();
+    EXPECT_FALSE(ring.finished());
+    EXPECT_EQ(ring.consume(10, [&](std::string&& x) { consumed += x; }), 2u);
+    EXPECT_TRUE(ring.finished());
+    EXPECT_EQ(consumed, "abcdf");
+}
+
+}  // namespace
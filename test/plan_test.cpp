@@ -0,0 +1,75 @@
+#include "easymatch/plan.hpp"
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace easymatch;
+using namespace std::string_literals;
+
+namespace {
+
+TEST(Plan, strategies_at_compile_time) {
+    constexpr auto m = matcher(
+        pattern | one_of(1, 2, 3)                = 1,
+        pattern | (_ < 0)                        = 2,
+        pattern | any_of((_ < 5), (_ > 1000))    = 3,
+        pattern | not_(one_of(7, 8))             = 4,
+        pattern | when([](int x) { return x % 2 == 0; }) = 5,
+        pattern | _                              = 6
+    );
+    constexpr auto plan = plan_v<decltype(m)>;
+    static_assert(plan.size() == 6);
+    static_assert(plan[0].strategy == arm_strategy::fixed_set && plan[0].table_size == 3);
+    static_assert(plan[1].strategy == arm_strategy::compare);
+    static_assert(plan[2].strategy == arm_strategy::interval && plan[2].table_size == 2);
+    static_assert(plan[3].strategy == arm_strategy::not_ && plan[3].operands == 1);
+    static_assert(plan[4].strategy == arm_strategy::guard);
+    static_assert(plan[5].strategy == arm_strategy::always);
+    static_assert(expect_plan<decltype(m), arm_strategy::fixed_set, arm_strategy::compare, arm_strategy::interval,
+                              arm_strategy::not_, arm_strategy::guard, arm_strategy::always>());
+    static_assert(plan_of(m)[0].table_size == 3);
+    EXPECT_EQ(m(2), 1);
+    EXPECT_EQ(m(500), 4);
+    EXPECT_EQ(m(8), 5);
+    EXPECT_EQ(m(7), 6);
+
+    constexpr auto literals = matcher(
+        pattern | 5                          = 1,
+        pattern | when(7)                    = 2,
+        pattern | when([](int x) { return x > 9; }) = 3,
+        pattern | _                          = 4
+    );
+    static_assert(expect_plan<decltype(literals), arm_strategy::compare, arm_strategy::compare, arm_strategy::guard,
+                              arm_strategy::always>());
+    EXPECT_EQ(literals(5), 1);
+    EXPECT_EQ(literals(7), 2);
+    EXPECT_EQ(describe(literals), "4 arms, tried in order\n  0: compare ==\n  1: compare ==\n  2: guard\n  3: always\n");
+}
+
+TEST(Plan, describe) {
+    std::vector<int> sparse;
+    for (int i = 0; i < 100; ++i) {
+        sparse.push_back(i * 1000);
+    }
+    auto m = matcher(
+        pattern | one_of(1, 2, 3)                      = "small"s,
+        pattern | one_of(1, 1000000)                   = "far"s,
+        pattern | one_of(sparse, set_options{true})    = "sparse"s,
+        pattern | all_of((_ > 0), (_ != 5))            = "positive"s,
+        pattern | _                                    = "other"s
+    );
+    auto text = describe(m);
+    EXPECT_EQ(text,
+        "5 arms, tried in order\n"
+        "  0: fixed_set bit mask, 3 values\n"
+        "  1: fixed_set binary search, 2 values\n"
+        "  2: value_set hashed, 100 values, " + std::to_string(one_of(sparse, set_options{true})
+                                                   .condition.set->prefilter_bytes()) + " byte prefilter\n"
+        "  3: all_of(compare >, compare !=)\n"
+        "  4: always\n");
+    EXPECT_EQ(m(3000), "sparse");
+}
+
+}  // namespace
@@ -0,0 +1,92 @@
+#include "easymatch/poly_vector.hpp"
+
+#include <sstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+using namespace easymatch;
+
+namespace {
+
+struct Circle {
+    double r;
+};
+
+struct Square {
+    double side;
+};
+
+struct Label {
+    std::string text;
+};
+
+using Shapes = poly_vector<Circle, Square, Label>;
+
+Shapes make_shapes() {
+    Shapes shapes;
+    shapes.push_back(Circle{1.0});
+    shapes.push_back(Square{2.0});
+    shapes.emplace_back<Label>(Label{"a"});
+    shapes.push_back(Circle{3.0});
+    shapes.push_back(Square{4.0});
+    return shapes;
+}
+
+TEST(PolyVector, segments) {
+    auto shapes = make_shapes();
+    EXPECT_EQ(shapes.size(), 5u);
+    EXPECT_EQ(shapes.segment<Circle>().size(), 2u);
+    EXPECT_EQ(shapes.segment<Square>().size(), 2u);
+    EXPECT_EQ(shapes.segment<Label>().size(), 1u);
+
+    shapes.clear();
+    EXPECT_TRUE(shapes.empty());
+    EXPECT_TRUE(shapes.segment<Circle>().empty());
+}
+
+TEST(PolyVector, match_all) {
+    auto shapes = make_shapes();
+    std::stringstream ss;
+    shapes.match_all(
+        pattern | as<Circle>                                      = [&](const Circle& x) { ss << "c" << x.r << " "; },
+        pattern | as<Square> | when([](auto&& x) { return x.side > 3; }) = [&](const Square& x) { ss << "S" << x.side << " "; },
+        pattern | as<Square>                                      = [&](const Square& x) { ss << "s" << x.side << " "; },
+        pattern | _                                               = [&] { ss << "other "; }
+    );
+    EXPECT_EQ(ss.str(), "c1 c3 s2 S4 other ");
+}
+
+TEST(PolyVector, match_all_by_reference) {
+    auto shapes = make_shapes();
+    shapes.match_all(
+        pattern | as<Circle> = [](Circle& x) { x.r *= 2; },
+        pattern | _          = [] {}
+    );
+    EXPECT_EQ(shapes.segment<Circle>()[0].r, 2.0);
+    EXPECT_EQ(shapes.segment<Circle>()[1].r, 6.0);
+}
+
+TEST(PolyVector, match_ordered) {
+    auto shapes = make_shapes();
+    std::stringstream ss;
+    shapes.match_ordered(
+        pattern | as<Circle> = [&](const Circle& x) { ss << "c" << x.r << " "; },
+        pattern | as<Square> = [&](const Square& x) { ss << "s" << x.side << " "; },
+        pattern | as<Label>  = [&](const Label& x)  { ss << x.text << " "; }
+    );
+    EXPECT_EQ(ss.str(), "c1 s2 a c3 s4 ");
+}
+
+TEST(PolyVector, unmatched) {
+    auto shapes = make_shapes();
+    auto visit = [&] {
+        shapes.match_all(
+            pattern | as<Circle> = [] {},
+            pattern | as<Square> = [] {}
+        );
+    };
+    EXPECT_THROW(visit(), std::runtime_error);
+}
+
+}  // namespace
@@ -0,0 +1,129 @@
+#include "easymatch/sequence.hpp"
+
+#include <string>
+#include <variant>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace easymatch;
+
+namespace {
+
+struct Login {
+    int user;
+};
+
+struct Purchase {
+    int user;
+    int amount;
+};
+
+struct Logout {
+    int user;
+};
+
+using Event = std::variant<Login, Purchase, Logout>;
+
+const auto user_of = [](const Event& e) {
+    return std::visit([](const auto& x) { return x.user; }, e);
+};
+
+struct Found {
+    size_t rule;
+    int user;
+    uint64_t first;
+    uint64_t last;
+};
+
+TEST(Sequence, then_within_window) {
+    std::vector<Found> found;
+    auto detector = make_sequence_matcher<Event>(user_of,
+        [&](int user, const sequence_match& m) { found.push_back({m.rule, user, m.first_position, m.last_position}); },
+        seq(3, pattern | as<Login>, pattern | as<Purchase> | when([](const Purchase& x) { return x.amount > 100; }))
+    );
+
+    detector.feed(Login{1});           // 0
+    detector.feed(Login{2});           // 1
+    detector.feed(Purchase{2, 50});    // 2
+    detector.feed(Purchase{1, 500});   // 3
+    detector.feed(Logout{1});          // 4
+    detector.feed(Purchase{2, 500});   // 5: 5 - 1 > 3, too late
+
+    ASSERT_EQ(found.size(), 1u);
+    EXPECT_EQ(found[0].rule, 0u);
+    EXPECT_EQ(found[0].user, 1);
+    EXPECT_EQ(found[0].first, 0u);
+    EXPECT_EQ(found[0].last, 3u);
+    EXPECT_EQ(detector.active(), 0u);
+}
+
+TEST(Sequence, absent_between_steps) {
+    std::vector<Found> found;
+    auto detector = make_sequence_matcher<Event>(user_of,
+        [&](int user, const sequence_match& m) { found.push_back({m.rule, user, m.first_position, m.last_position}); },
+        seq(10, pattern | as<Login>, absent(pattern | as<Logout>), pattern | as<Purchase>)
+    );
+
+    detector.feed(Login{1});
+    detector.feed(Login{2});
+    detector.feed(Logout{1});
+    detector.feed(Purchase{1, 1});
+    detector.feed(Purchase{2, 1});
+
+    ASSERT_EQ(found.size(), 1u);
+    EXPECT_EQ(found[0].user, 2);
+}
+
+TEST(Sequence, trailing_absent_completes_on_expiry) {
+    std::vector<Found> found;
+    auto detector = make_sequence_matcher<Event>(user_of,
+        [&](int user, const sequence_match& m) { found.push_back({m.rule, user, m.first_position, m.last_position}); },
+        seq(2, pattern | as<Login>, pattern | as<Purchase>, absent(pattern | as<Logout>))
+    );
+
+    detector.feed(Login{1});        // 0
+    detector.feed(Purchase{1, 1});  // 1
+    detector.feed(Login{2});        // 2
+    detector.feed(Purchase{2, 1});  // 3
+    detector.feed(Logout{2});       // 4: user 2 logs out within the window
+    EXPECT_TRUE(found.empty());
+
+    detector.feed(Login{3});        // 5
+    detector.expire();
+
+    ASSERT_EQ(found.size(), 1u);
+    EXPECT_EQ(found[0].user, 1);
+    EXPECT_EQ(found[0].first, 0u);
+    EXPECT_EQ(found[0].last, 2u);
+}
+
+TEST(Sequence, many_rules) {
+    std::vector<Found> found;
+    auto detector = make_sequence_matcher<Event>(user_of,
+        [&](int user, const sequence_match& m) { found.push_back({m.rule, user, m.first_position, m.last_position}); },
+        seq(5, pattern | as<Login>, pattern | as<Logout>),
+        seq(5, pattern | as<Login>, pattern | as<Purchase>, pattern | as<Logout>),
+        seq(5, pattern | as<Logout>)
+    );
+
+    detector.feed(Login{1});
+    detector.feed(Purchase{1, 1});
+    detector.feed(Logout{1});
+
+    ASSERT_EQ(found.size(), 3u);
+    EXPECT_EQ(found[0].rule, 0u);
+    EXPECT_EQ(found[1].rule, 1u);
+    EXPECT_EQ(found[2].rule, 2u);
+    EXPECT_EQ(detector.active(), 0u);
+}
+
+TEST(Sequence, must_start_with_present_step) {
+    auto make = [] {
+        return make_sequence_matcher<Event>(user_of, [](int, const sequence_match&) {},
+            seq(5, absent(pattern | as<Logout>), pattern | as<Login>));
+    };
+    EXPECT_THROW(make(), std::invalid_argument);
+}
+
+}  // namespace
@@ -0,0 +1,159 @@
+#include "easymatch/term.hpp"
+
+#include <tuple>
+
+#include <gtest/gtest.h>
+
+using namespace easymatch;
+
+namespace {
+
+struct Num;
+struct Var;
+struct Add;
+struct Mul;
+using Expr = term<Num, Var, Add, Mul>;
+
+struct Num {
+    long value;
+    auto fields() const { return std::tie(value); }
+};
+
+struct Var {
+    char name;
+    auto fields() const { return std::tie(name); }
+};
+
+struct Add {
+    const Expr* lhs;
+    const Expr* rhs;
+    auto fields() const { return std::tie(lhs, rhs); }
+};
+
+struct Mul {
+    const Expr* lhs;
+    const Expr* rhs;
+    auto fields() const { return std::tie(lhs, rhs); }
+};
+
+bool is_num(const Expr* e, long value) {
+    return std::holds_alternative<Num>(*e) && std::get<Num>(*e).value == value;
+}
+
+bool is_num(const Expr* e) {
+    return std::holds_alternative<Num>(*e);
+}
+
+auto simplifier(term_arena<Expr>& arena) {
+    return make_rewriter(arena,
+        pattern | as<Add> | when([](const Add& x) { return is_num(x.rhs, 0); }) = [](const Add& x) {
+            return x.lhs;
+        },
+        pattern | as<Mul> | when([](const Mul& x) { return is_num(x.rhs, 1); }) = [](const Mul& x) {
+            return x.lhs;
+        },
+        pattern | as<Add> | when([](const Add& x) { return is_num(x.lhs) && is_num(x.rhs); }) = [&](const Add& x) {
+            return arena.make<Num>(std::get<Num>(*x.lhs).value + std::get<Num>(*x.rhs).value);
+        },
+        pattern | _ = [] { return static_cast<const Expr*>(nullptr); }
+    );
+}
+
+TEST(Term, arena) {
+    term_arena<Expr> arena(2);
+    auto x = arena.make<Var>('x');
+    auto one = arena.make<Num>(1);
+    auto sum = arena.make<Add>(x, one);
+    EXPECT_EQ(arena.size(), 3u);
+    EXPECT_TRUE(std::holds_alternative<Add>(*sum));
+    EXPECT_EQ(std::get<Add>(*sum).lhs, x);
+
+    arena.clear();
+    EXPECT_EQ(arena.size(), 0u);
+}
+
+TEST(Term, rewrite_to_fixpoint) {
+    term_arena<Expr> arena;
+    auto x = arena.make<Var>('x');
+    // ((x * 1) + ((2 + 3) + 0))
+    auto root = arena.make<Add>(
+        arena.make<Mul>(x, arena.make<Num>(1)),
+        arena.make<Add>(arena.make<Add>(arena.make<Num>(2), arena.make<Num>(3)), arena.make<Num>(0))
+    );
+
+    auto rewrite = simplifier(arena);
+    auto result = rewrite(root);
+
+    ASSERT_TRUE(std::holds_alternative<Add>(*result));
+    EXPECT_EQ(std::get<Add>(*result).lhs, x);
+    EXPECT_TRUE(is_num(std::get<Add>(*result).rhs, 5));
+
+    auto counts = rewrite.counts();
+    EXPECT_EQ(counts[0], 1u);
+    EXPECT_EQ(counts[1], 1u);
+    EXPECT_EQ(counts[2], 1u);
+    EXPECT_EQ(counts[3], 0u);
+}
+
+TEST(Term, unchanged_subtree_is_shared) {
+    term_arena<Expr> arena;
+    auto x = arena.make<Var>('x');
+    auto unchanged = arena.make<Mul>(x, arena.make<Num>(2));
+    auto root = arena.make<Add>(unchanged, arena.make<Add>(arena.make<Num>(1), arena.make<Num>(1)));
+
+    auto rewrite = simplifier(arena);
+    auto result = rewrite(root);
+    EXPECT_EQ(std::get<Add>(*result).lhs, unchanged);
+    EXPECT_TRUE(is_num(std::get<Add>(*result).rhs, 2));
+
+    auto size = arena.size();
+    EXPECT_EQ(rewrite(root), result);
+    EXPECT_EQ(rewrite(unchanged), unchanged);
+    EXPECT_EQ(arena.size(), size);
+}
+
+TEST(Term, hash_cons) {
+    hash_cons_arena<Expr> arena;
+    auto x1 = arena.make<Var>('x');
+    auto x2 = arena.make<Var>('x');
+    auto y = arena.make<Var>('y');
+    EXPECT_EQ(x1, x2);
+    EXPECT_NE(x1, y);
+
+    auto sum1 = arena.make<Add>(x1, arena.make<Num>(1));
+    auto sum2 = arena.make<Add>(x2, arena.make<Num>(1));
+    auto mul = arena.make<Mul>(x1, arena.make<Num>(1));
+    EXPECT_EQ(sum1, sum2);
+    EXPECT_NE(sum1, mul);
+    EXPECT_EQ(arena.size(), 5u);
+
+    for (long i = 0; i < 1000; ++i) {
+        EXPECT_EQ(arena.make<Num>(i), arena.make<Num>(i));
+    }
+    EXPECT_EQ(arena.size(), 5u + 999u);
+
+    arena.clear();
+    EXPECT_EQ(arena.size(), 0u);
+}
+
+TEST(Term, rewrite_with_hash_cons) {
+    hash_cons_arena<Expr> arena;
+    auto zero = arena.make<Num>(0);
+    auto rewrite = make_rewriter(arena,
+        pattern | as<Add> | when([&](const Add& x) { return x.rhs == zero; }) = [](const Add& x) {
+            return x.lhs;
+        },
+        pattern | _ = [] { return static_cast<const Expr*>(nullptr); }
+    );
+
+    auto x = arena.make<Var>('x');
+    auto shared = arena.make<Add>(x, zero);
+    auto root = arena.make<Mul>(arena.make<Add>(x, zero), shared);
+    EXPECT_EQ(std::get<Mul>(*root).lhs, shared);
+
+    auto result = rewrite(root);
+    EXPECT_EQ(result, arena.make<Mul>(x, x));
+    EXPECT_EQ(rewrite.counts()[0], 1u);
+}
+
+}  // namespace